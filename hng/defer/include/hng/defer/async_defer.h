@@ -0,0 +1,321 @@
+#ifndef HNG_ASYNC_DEFER_HEADERGUARD
+#define HNG_ASYNC_DEFER_HEADERGUARD
+//
+//	Licence:	MIT
+//	GitHub:		https://github.com/highestnamegames/defer
+//	Version:	v1.1.0
+//
+//	Summary:
+//		Moves expensive scope-exit cleanup off the calling thread.
+//		At the end of the scope the callable is pushed onto a lock-free queue,
+//		and a background worker owned by an async_defer_executor invokes it.
+//		Compatible with C++17.
+//
+//	Example:
+//		```
+//			hng::async_defer_executor executor;
+//			// ...
+//			{
+//				auto cache = build_cache();
+//				cache_type& view = *cache;
+//				// The callable owns the cache; at the end of the scope it is handed to the worker.
+//				hng::async_defer const release_cache(executor, [cache = std::move(cache)]() mutable noexcept { cache.reset(); });
+//				// ... use view ...
+//			}
+//		```
+//
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <hng/defer/defer_core.h>
+
+namespace hng {
+	namespace detail {
+		namespace async_defer {
+
+			// A queued cleanup. `m_run` invokes the callable and destroys the task.
+			struct task
+			{
+				std::atomic<task*> m_next{ nullptr };
+				void (*m_run)(task*) noexcept = nullptr;
+			};
+
+			template<class Callable>
+			struct callable_task : task
+			{
+				Callable m_callable;
+
+				inline explicit callable_task(Callable&& callable) noexcept(std::is_nothrow_move_constructible<Callable>::value)
+					: m_callable(std::move(callable)) {
+					m_run = &run;
+				}
+
+				static inline void run(task* t) noexcept {
+					callable_task* const self = static_cast<callable_task*>(t);
+					std::move(self->m_callable)();
+					delete self;
+				}
+			};
+
+			// Intrusive multi-producer single-consumer queue (Vyukov).
+			// Pushing is one atomic exchange and one store, and never blocks.
+			// Popping may briefly see the queue as empty while a push is half done.
+			class mpsc_queue
+			{
+			private:
+				task m_stub;
+				std::atomic<task*> m_tail;
+				task* m_head;
+			public:
+				inline mpsc_queue(mpsc_queue const&) = delete;
+				inline mpsc_queue& operator=(mpsc_queue const&) = delete;
+				inline mpsc_queue() noexcept : m_stub(), m_tail(&m_stub), m_head(&m_stub) {}
+
+				inline void push(task* t) noexcept {
+					t->m_next.store(nullptr, std::memory_order_relaxed);
+					task* const prev = m_tail.exchange(t, std::memory_order_acq_rel);
+					prev->m_next.store(t, std::memory_order_release);
+				}
+
+				// Consumer only.
+				inline task* pop() noexcept {
+					task* head = m_head;
+					task* next = head->m_next.load(std::memory_order_acquire);
+					if (head == &m_stub) {
+						if (!next)
+							return nullptr;
+						m_head = next;
+						head = next;
+						next = next->m_next.load(std::memory_order_acquire);
+					}
+					if (next) {
+						m_head = next;
+						return head;
+					}
+					if (head != m_tail.load(std::memory_order_acquire))
+						return nullptr;
+					push(&m_stub);
+					next = head->m_next.load(std::memory_order_acquire);
+					if (next) {
+						m_head = next;
+						return head;
+					}
+					return nullptr;
+				}
+			};
+
+		}
+	}
+
+	// What async_defer_executor::submit does when the queue already holds `capacity` cleanups.
+	enum class async_defer_overflow
+	{
+		block,		// wait for the worker to make room
+		run_inline,	// invoke the cleanup on the calling thread
+	};
+
+	struct async_defer_config
+	{
+		std::size_t capacity = 4096;
+		async_defer_overflow overflow = async_defer_overflow::block;
+	};
+
+	// Owns the background worker which runs the cleanups submitted by hng::async_defer.
+	// Cleanups run one at a time, in the order they were pushed onto the queue.
+	class async_defer_executor
+	{
+	private:
+		async_defer_config m_config;
+		detail::async_defer::mpsc_queue m_queue;
+		// Cleanups which are queued or running; bounded by the capacity.
+		std::atomic<std::size_t> m_pending{ 0 };
+		std::atomic<std::size_t> m_submitted{ 0 };
+		std::atomic<std::size_t> m_completed{ 0 };
+		// Threads waiting in flush() or for room in the queue.
+		std::atomic<int> m_waiters{ 0 };
+		std::atomic<bool> m_worker_parked{ false };
+		std::atomic<bool> m_stopping{ false };
+		std::atomic<bool> m_drained{ false };
+		std::mutex m_mutex;
+		std::condition_variable m_work_cv;
+		std::condition_variable m_progress_cv;
+		std::thread m_worker;
+
+		inline bool has_work() const noexcept {
+			return m_submitted.load(std::memory_order_seq_cst) != m_completed.load(std::memory_order_seq_cst);
+		}
+
+		inline void work() noexcept {
+			for (;;) {
+				if (detail::async_defer::task* const t = m_queue.pop()) {
+					t->m_run(t);
+					m_pending.fetch_sub(1, std::memory_order_seq_cst);
+					m_completed.fetch_add(1, std::memory_order_seq_cst);
+					if (m_waiters.load(std::memory_order_seq_cst) != 0) {
+						std::lock_guard<std::mutex> const lock(m_mutex);
+						m_progress_cv.notify_all();
+					}
+					continue;
+				}
+				if (has_work()) {
+					// A push is half done.
+					std::this_thread::yield();
+					continue;
+				}
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_worker_parked.store(true, std::memory_order_seq_cst);
+				m_work_cv.wait(lock, [this] { return has_work() || m_stopping.load(std::memory_order_seq_cst); });
+				m_worker_parked.store(false, std::memory_order_relaxed);
+				if (!has_work() && m_stopping.load(std::memory_order_relaxed))
+					return;
+			}
+		}
+
+		template<class Predicate>
+		inline void wait_for_progress(Predicate predicate) {
+			m_waiters.fetch_add(1, std::memory_order_seq_cst);
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_progress_cv.wait(lock, predicate);
+			}
+			m_waiters.fetch_sub(1, std::memory_order_relaxed);
+		}
+
+		// Reserves a slot in the queue, or returns false if the cleanup should run inline.
+		inline bool reserve() noexcept {
+			std::size_t pending = m_pending.load(std::memory_order_relaxed);
+			for (;;) {
+				if (pending < m_config.capacity) {
+					if (m_pending.compare_exchange_weak(pending, pending + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+						return true;
+					continue;
+				}
+				if (m_config.overflow == async_defer_overflow::run_inline)
+					return false;
+				DETAIL_HNG_DEFER_TRY {
+					wait_for_progress([this] { return m_pending.load(std::memory_order_seq_cst) < m_config.capacity; });
+				}
+				DETAIL_HNG_DEFER_CATCH_ALL {
+					return false;
+				}
+				pending = m_pending.load(std::memory_order_relaxed);
+			}
+		}
+
+	public:
+		inline ~async_defer_executor() noexcept { drain(); }
+		inline async_defer_executor(async_defer_executor const&) = delete;
+		inline async_defer_executor(async_defer_executor&&) = delete;
+		inline async_defer_executor& operator=(async_defer_executor const&) = delete;
+		inline async_defer_executor& operator=(async_defer_executor&&) = delete;
+		inline async_defer_executor() : async_defer_executor(async_defer_config()) {}
+		inline explicit async_defer_executor(async_defer_config config)
+			: m_config(config) {
+			if (m_config.capacity == 0)
+				m_config.capacity = 1;
+			m_worker = std::thread([this] { work(); });
+		}
+
+		inline async_defer_config const& config() const noexcept { return m_config; }
+
+		// The number of cleanups which are queued or running.
+		inline std::size_t pending() const noexcept { return m_pending.load(std::memory_order_relaxed); }
+
+		// Hands the callable to the worker.
+		// The callable is invoked on the calling thread instead if the executor is drained,
+		// if the queue is full and the overflow policy is run_inline, or if allocating the task fails.
+		template<class Callable>
+		#if (defined(__cpp_concepts) && __cpp_concepts >= 201907L)
+		requires (noexcept(std::declval<std::decay_t<Callable>&&>()()))
+		#endif
+		inline void submit(Callable&& callable) noexcept {
+			using callable_type = std::decay_t<Callable>;
+			static_assert(std::is_nothrow_move_constructible<callable_type>::value || std::is_nothrow_copy_constructible<callable_type>::value,
+				"the callable must be nothrow move constructible");
+			if (m_drained.load(std::memory_order_acquire) || !reserve()) {
+				std::forward<Callable>(callable)();
+				return;
+			}
+			auto* const t = new (std::nothrow) detail::async_defer::callable_task<callable_type>(callable_type(std::forward<Callable>(callable)));
+			if (!t) {
+				m_pending.fetch_sub(1, std::memory_order_relaxed);
+				std::forward<Callable>(callable)();
+				return;
+			}
+			m_submitted.fetch_add(1, std::memory_order_seq_cst);
+			m_queue.push(t);
+			if (m_worker_parked.load(std::memory_order_seq_cst)) {
+				std::lock_guard<std::mutex> const lock(m_mutex);
+				m_work_cv.notify_one();
+			}
+		}
+
+		// Blocks until every cleanup submitted before the call has run.
+		inline void flush() {
+			std::size_t const target = m_submitted.load(std::memory_order_seq_cst);
+			if (m_completed.load(std::memory_order_seq_cst) >= target)
+				return;
+			wait_for_progress([this, target] { return m_completed.load(std::memory_order_seq_cst) >= target; });
+		}
+
+		// Runs every queued cleanup and stops the worker.
+		// Cleanups submitted afterwards run on the submitting thread.
+		// Must not be called while other threads submit.
+		inline void drain() noexcept {
+			if (m_drained.load(std::memory_order_acquire))
+				return;
+			{
+				std::lock_guard<std::mutex> const lock(m_mutex);
+				m_stopping.store(true, std::memory_order_seq_cst);
+				m_work_cv.notify_one();
+			}
+			m_worker.join();
+			m_drained.store(true, std::memory_order_release);
+		}
+	};
+
+	// Submits the callable to an async_defer_executor at the end of the scope.
+	// The callable runs on another thread after the scope is gone, so it must own what it uses.
+	template<class Callable>
+	#if (defined(__cpp_concepts) && __cpp_concepts >= 201907L)
+	requires (noexcept(std::declval<Callable&&>()()))
+	#endif
+	class async_defer
+	{
+	private:
+		async_defer_executor& m_executor;
+		Callable m_callable;
+	public:
+		inline ~async_defer() noexcept { m_executor.submit(std::move(m_callable)); }
+		inline async_defer(async_defer const&) = delete;
+		inline async_defer(async_defer&&) = delete;
+		inline async_defer& operator=(async_defer const&) = delete;
+		inline async_defer& operator=(async_defer&&) = delete;
+		inline async_defer(async_defer_executor& executor, Callable&& callable) noexcept(std::is_nothrow_move_constructible<Callable>::value)
+			: m_executor(executor), m_callable(std::move(callable)) {}
+		inline async_defer(async_defer_executor& executor, Callable const& callable) noexcept(std::is_nothrow_copy_constructible<Callable>::value)
+			: m_executor(executor), m_callable(callable) {}
+	};
+}
+
+
+/*	Example:
+	```
+		int const fd = ::open(path, O_RDONLY);
+		HNG_ASYNC_DEFER_BLOCK(executor, {
+			::close(fd);
+		});
+	```
+	The block captures by copy, when it is declared.
+*/
+#define HNG_ASYNC_DEFER_BLOCK(executor,...)\
+	auto DETAIL_HNG_DEFER_CAT(HNG_ASYNC_DEFER_fn_,DETAIL_HNG_DEFER_LINEGENNAME)=[=]()mutable noexcept{__VA_ARGS__};\
+	::hng::async_defer<decltype(DETAIL_HNG_DEFER_CAT(HNG_ASYNC_DEFER_fn_,DETAIL_HNG_DEFER_LINEGENNAME))> const DETAIL_HNG_DEFER_CAT(HNG_ASYNC_DEFER_var_,DETAIL_HNG_DEFER_LINEGENNAME)((executor),::std::move(DETAIL_HNG_DEFER_CAT(HNG_ASYNC_DEFER_fn_,DETAIL_HNG_DEFER_LINEGENNAME)));do{}while(0)
+
+#endif // ^^^ HNG_ASYNC_DEFER_HEADERGUARD
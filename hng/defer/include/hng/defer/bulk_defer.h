@@ -0,0 +1,126 @@
+#ifndef HNG_BULK_DEFER_HEADERGUARD
+#define HNG_BULK_DEFER_HEADERGUARD
+//
+//	Licence:	MIT
+//	GitHub:		https://github.com/highestnamegames/defer
+//	Version:	v1.1.0
+//
+//	Summary:
+//		Collects many handles of the same kind, and releases them with one call
+//		to a batch function at the end of the scope.
+//		When the inline array is full, the batch function is invoked early
+//		and the array is reused.
+//
+//	Example:
+//		```
+//			auto const release_slots = [&](hng::bulk_span<slot_id> slots)noexcept{
+//				pool.release(slots.data(), slots.size());
+//			};
+//			hng::bulk_defer<slot_id, 64, decltype(release_slots)> slots_defer(release_slots);
+//			for (auto& item : request.items) {
+//				slot_id const slot = pool.acquire();
+//				slots_defer.push(slot);
+//				// ... use slot ...
+//			}
+//		```
+//
+
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <type_traits>
+
+#if (defined(__cpp_lib_span) && __cpp_lib_span >= 202002L)
+#include <span>
+#endif
+
+namespace hng {
+
+	// A contiguous range of handles passed to a bulk_defer batch function.
+	template<class T>
+	class bulk_span
+	{
+	private:
+		T* m_data;
+		std::size_t m_size;
+	public:
+		inline constexpr bulk_span(T* data, std::size_t size) noexcept : m_data(data), m_size(size) {}
+		inline constexpr T* data() const noexcept { return m_data; }
+		inline constexpr std::size_t size() const noexcept { return m_size; }
+		inline constexpr bool empty() const noexcept { return m_size == 0; }
+		inline constexpr T* begin() const noexcept { return m_data; }
+		inline constexpr T* end() const noexcept { return m_data + m_size; }
+		inline constexpr T& operator[](std::size_t i) const noexcept { return m_data[i]; }
+#if (defined(__cpp_lib_span) && __cpp_lib_span >= 202002L)
+		inline constexpr operator std::span<T>() const noexcept { return std::span<T>(m_data, m_size); }
+#endif
+	};
+
+	// Defers a call of `BatchFn(hng::bulk_span<T>)` for all the pushed handles to the end of the scope.
+	// Up to `N` handles are stored inline; pushing onto a full array first flushes it.
+	template<class T, std::size_t N, class BatchFn>
+	#if (defined(__cpp_concepts) && __cpp_concepts >= 201907L)
+	requires (noexcept(std::declval<BatchFn&>()(std::declval<bulk_span<T>>())))
+	#endif
+	class bulk_defer
+	{
+		static_assert(N > 0, "the inline capacity must not be zero");
+		static_assert(std::is_nothrow_destructible<T>::value, "handles must be nothrow destructible");
+		static_assert(noexcept(std::declval<BatchFn&>()(std::declval<bulk_span<T>>())), "the batch function must be noexcept");
+	private:
+		BatchFn m_batch_fn;
+		std::size_t m_size;
+		alignas(T) unsigned char m_storage[N * sizeof(T)];
+
+		inline T* items() noexcept { return reinterpret_cast<T*>(m_storage); }
+
+		inline void destroy_items() noexcept {
+			T* const first = items();
+			for (std::size_t i = 0; i < m_size; ++i) {
+				first[i].~T();
+			}
+			m_size = 0;
+		}
+	public:
+		inline ~bulk_defer() noexcept { flush(); }
+		inline bulk_defer(bulk_defer const&) = delete;
+		inline bulk_defer(bulk_defer&&) = delete;
+		inline bulk_defer& operator=(bulk_defer const&) = delete;
+		inline bulk_defer& operator=(bulk_defer&&) = delete;
+		inline bulk_defer() noexcept(std::is_nothrow_default_constructible<BatchFn>::value) : m_batch_fn(), m_size(0) {}
+		inline explicit bulk_defer(BatchFn&& batch_fn) noexcept(std::is_nothrow_move_constructible<BatchFn>::value) : m_batch_fn(std::move(batch_fn)), m_size(0) {}
+		inline explicit bulk_defer(BatchFn const& batch_fn) noexcept(std::is_nothrow_copy_constructible<BatchFn>::value) : m_batch_fn(batch_fn), m_size(0) {}
+
+		static constexpr std::size_t capacity() noexcept { return N; }
+		inline std::size_t size() const noexcept { return m_size; }
+		inline bool empty() const noexcept { return m_size == 0; }
+
+		// Adds a handle. If the array is full, the batch function is invoked for the stored handles first.
+		// If constructing the handle throws, nothing is added.
+		template<class... Args>
+		inline T& emplace(Args&&... args) {
+			if (m_size == N) {
+				flush();
+			}
+			T* const item = ::new (static_cast<void*>(items() + m_size)) T(std::forward<Args>(args)...);
+			++m_size;
+			return *item;
+		}
+
+		inline void push(T const& item) { emplace(item); }
+		inline void push(T&& item) { emplace(std::move(item)); }
+
+		// Invokes the batch function for the stored handles now, and empties the array.
+		inline void flush() noexcept {
+			if (m_size != 0) {
+				m_batch_fn(bulk_span<T>(items(), m_size));
+				destroy_items();
+			}
+		}
+
+		// Empties the array without invoking the batch function.
+		inline void release() noexcept { destroy_items(); }
+	};
+}
+
+#endif // ^^^ HNG_BULK_DEFER_HEADERGUARD
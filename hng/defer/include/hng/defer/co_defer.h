@@ -0,0 +1,344 @@
+#ifndef HNG_CO_DEFER_HEADERGUARD
+#define HNG_CO_DEFER_HEADERGUARD
+//
+//	Licence:	MIT
+//	GitHub:		https://github.com/highestnamegames/defer
+//	Version:	v1.1.0
+//
+//	Summary:
+//		Asynchronous scope-exit cleanup for C++20 coroutines.
+//		A coroutine registers cleanups which may themselves be awaitable (flushing a socket, committing a log segment),
+//		and the cleanups are awaited in reverse order of registration when the scope completes,
+//		whether the scope returned or threw. No thread is blocked.
+//		Exceptions are propagated like HNG_DT_DEFER_FINALLY_PRESERVE.
+//		Requires C++20 coroutines.
+//
+//	Example:
+//		```
+//			co_await hng::co_scope([&](hng::co_defer_scope& scope) -> hng::co_defer_task<> {
+//				auto connection = co_await connect(address);
+//				scope.co_defer([&]() { return connection.close(); }); // close() returns an awaitable
+//				co_await connection.send(request);
+//			});
+//		```
+//
+
+#include <hng/defer/defer.h>
+
+#if (defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L) && __has_include(<coroutine>)
+#define DETAIL_HNG_DEFER_HAS_COROUTINES 1
+#else
+#define DETAIL_HNG_DEFER_HAS_COROUTINES 0
+#endif
+
+#if DETAIL_HNG_DEFER_HAS_COROUTINES
+
+#include <coroutine>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace hng {
+
+	template<class T = void>
+	class co_defer_task;
+
+	namespace detail {
+		namespace co_defer {
+
+			// Resumes the awaiting coroutine (symmetric transfer) when the task completes.
+			struct final_awaiter
+			{
+				inline bool await_ready() const noexcept { return false; }
+				template<class Promise>
+				inline std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> h) const noexcept {
+					std::coroutine_handle<> const continuation = h.promise().m_continuation;
+					return continuation ? continuation : std::noop_coroutine();
+				}
+				inline void await_resume() const noexcept {}
+			};
+
+			struct promise_common
+			{
+				std::coroutine_handle<> m_continuation;
+				std::exception_ptr m_exception;
+
+				inline std::suspend_always initial_suspend() const noexcept { return {}; }
+				inline final_awaiter final_suspend() const noexcept { return {}; }
+				inline void unhandled_exception() noexcept { m_exception = std::current_exception(); }
+
+				inline void rethrow_if_exception() {
+					if (m_exception) {
+						std::rethrow_exception(std::move(m_exception));
+					}
+				}
+			};
+
+			template<class T>
+			struct promise_value : promise_common
+			{
+				std::optional<T> m_value;
+
+				template<class U = T>
+				inline void return_value(U&& value) { m_value.emplace(std::forward<U>(value)); }
+
+				inline T take() {
+					rethrow_if_exception();
+					return std::move(*m_value);
+				}
+			};
+
+			// A reference result is held as a pointer, and returned with its value category.
+			template<class T>
+			struct promise_reference : promise_common
+			{
+				std::remove_reference_t<T>* m_value = nullptr;
+
+				inline void return_value(T value) noexcept { m_value = std::addressof(value); }
+
+				inline T take() {
+					rethrow_if_exception();
+					return static_cast<T>(*m_value);
+				}
+			};
+
+			template<class T>
+			struct promise_value<T&> : promise_reference<T&> {};
+
+			template<class T>
+			struct promise_value<T&&> : promise_reference<T&&> {};
+
+			template<>
+			struct promise_value<void> : promise_common
+			{
+				inline void return_void() const noexcept {}
+				inline void take() { rethrow_if_exception(); }
+			};
+
+			// The type produced by `co_await std::declval<Awaitable>()`, for awaitables with a member
+			// operator co_await, and for awaiters.
+			template<class Awaitable>
+			decltype(auto) get_awaiter(Awaitable&& awaitable) {
+				if constexpr (requires { std::forward<Awaitable>(awaitable).operator co_await(); }) {
+					return std::forward<Awaitable>(awaitable).operator co_await();
+				}
+				else {
+					return std::forward<Awaitable>(awaitable);
+				}
+			}
+
+			template<class Awaitable>
+			using await_result_t = decltype(get_awaiter(std::declval<Awaitable>()).await_resume());
+
+			// Wraps the exception of a cleanup like HNG_DT_DEFER_FINALLY_PRESERVE:
+			// a hng::defer_exception holding the cleanup exception, with the earlier exception nested.
+			inline std::exception_ptr preserve(std::exception_ptr earlier, std::exception_ptr cleanup) noexcept {
+				if (!earlier)
+					return cleanup;
+#if DETAIL_HNG_DEFER_HAS_EXCEPTIONS
+				try {
+					try {
+						std::rethrow_exception(std::move(earlier));
+					}
+					catch (...) {
+						std::throw_with_nested(::hng::defer_exception(std::move(cleanup)));
+					}
+				}
+				catch (...) {
+					return std::current_exception();
+				}
+#else
+				return cleanup; // without exceptions, no cleanup can have thrown
+#endif // ^^^ DETAIL_HNG_DEFER_HAS_EXCEPTIONS
+			}
+
+			struct cleanup_base
+			{
+				virtual ~cleanup_base() = default;
+				virtual co_defer_task<void> run() = 0;
+			};
+
+			template<class Callable>
+			struct cleanup;
+
+		}
+	}
+
+	// A lazily started coroutine task which is awaited by exactly one coroutine.
+	// Used for the cleanups and the scope helper; any awaitable type may be awaited inside it.
+	template<class T>
+	class co_defer_task
+	{
+	public:
+		struct promise_type : detail::co_defer::promise_value<T>
+		{
+			inline co_defer_task get_return_object() noexcept { return co_defer_task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+		};
+
+	private:
+		std::coroutine_handle<promise_type> m_handle;
+
+		inline explicit co_defer_task(std::coroutine_handle<promise_type> handle) noexcept : m_handle(handle) {}
+
+		struct awaiter
+		{
+			std::coroutine_handle<promise_type> m_handle;
+
+			inline bool await_ready() const noexcept { return !m_handle || m_handle.done(); }
+			inline std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) const noexcept {
+				m_handle.promise().m_continuation = awaiting;
+				return m_handle;
+			}
+			inline T await_resume() const { return m_handle.promise().take(); }
+		};
+
+	public:
+		inline ~co_defer_task() noexcept {
+			if (m_handle) {
+				m_handle.destroy();
+			}
+		}
+		inline co_defer_task(co_defer_task const&) = delete;
+		inline co_defer_task& operator=(co_defer_task const&) = delete;
+		inline co_defer_task(co_defer_task&& other) noexcept : m_handle(std::exchange(other.m_handle, nullptr)) {}
+		inline co_defer_task& operator=(co_defer_task&& other) noexcept {
+			if (this != &other) {
+				if (m_handle) {
+					m_handle.destroy();
+				}
+				m_handle = std::exchange(other.m_handle, nullptr);
+			}
+			return *this;
+		}
+
+		inline awaiter operator co_await() const& noexcept { return awaiter{ m_handle }; }
+		inline awaiter operator co_await() const&& noexcept { return awaiter{ m_handle }; }
+	};
+
+	// Collects asynchronous cleanups for a coroutine scope.
+	// The cleanups only run when the scope is closed: use hng::co_scope, or `co_await scope.close()` on every path.
+	class co_defer_scope
+	{
+	private:
+		std::vector<std::unique_ptr<detail::co_defer::cleanup_base>> m_cleanups;
+	public:
+		inline co_defer_scope(co_defer_scope const&) = delete;
+		inline co_defer_scope(co_defer_scope&&) = delete;
+		inline co_defer_scope& operator=(co_defer_scope const&) = delete;
+		inline co_defer_scope& operator=(co_defer_scope&&) = delete;
+		inline co_defer_scope() = default;
+
+		// Registers a cleanup. `callable()` is invoked when the scope is closed;
+		// it may return an awaitable, which is awaited before the previous cleanup is started, or void.
+		template<class Callable>
+		inline void co_defer(Callable&& callable);
+
+		inline std::size_t size() const noexcept { return m_cleanups.size(); }
+
+		// Awaits the cleanups in reverse order of registration, and empties the scope.
+		// `scope_exception` is the exception which exited the scope, if any.
+		// If a cleanup throws while an exception is pending, the cleanup exception is propagated as a hng::defer_exception
+		// with the pending exception nested (as with HNG_DT_DEFER_FINALLY_PRESERVE), and the next cleanups still run.
+		// The resulting exception, or `scope_exception` when no cleanup throws, is rethrown.
+		inline co_defer_task<void> close(std::exception_ptr scope_exception = nullptr) {
+			std::vector<std::unique_ptr<detail::co_defer::cleanup_base>> cleanups = std::move(m_cleanups);
+			m_cleanups.clear();
+			std::exception_ptr pending = std::move(scope_exception);
+			for (auto it = cleanups.rbegin(); it != cleanups.rend(); ++it) {
+				std::exception_ptr cleanup_exception;
+				DETAIL_HNG_DEFER_TRY {
+					co_await (*it)->run();
+				}
+				DETAIL_HNG_DEFER_CATCH_ALL {
+					cleanup_exception = std::current_exception();
+				}
+				if (cleanup_exception) {
+					pending = detail::co_defer::preserve(std::move(pending), std::move(cleanup_exception));
+				}
+				it->reset();
+			}
+			if (pending) {
+				std::rethrow_exception(std::move(pending));
+			}
+		}
+	};
+
+	namespace detail {
+		namespace co_defer {
+
+			template<class Callable>
+			struct cleanup final : cleanup_base
+			{
+				Callable m_callable;
+
+				template<class C>
+				inline explicit cleanup(C&& callable) : m_callable(std::forward<C>(callable)) {}
+
+				// The callable lives in the scope until its awaitable completes,
+				// so a coroutine lambda's captures stay valid.
+				inline co_defer_task<void> run() override {
+					if constexpr (std::is_void_v<decltype(m_callable())>) {
+						m_callable();
+					}
+					else {
+						co_await m_callable();
+					}
+				}
+			};
+
+		}
+	}
+
+	template<class Callable>
+	inline void co_defer_scope::co_defer(Callable&& callable) {
+		m_cleanups.push_back(std::make_unique<detail::co_defer::cleanup<std::decay_t<Callable>>>(std::forward<Callable>(callable)));
+	}
+
+	// Awaits `body(scope)`, then awaits the cleanups which the body registered in `scope`,
+	// whether the body returned or threw, and returns the body's result (a reference result is returned as the same reference).
+	template<class Body>
+	auto co_scope(Body body) -> co_defer_task<detail::co_defer::await_result_t<std::invoke_result_t<Body&, co_defer_scope&>>> {
+		using result_type = detail::co_defer::await_result_t<std::invoke_result_t<Body&, co_defer_scope&>>;
+		co_defer_scope scope;
+		std::exception_ptr scope_exception;
+		if constexpr (std::is_void_v<result_type>) {
+			DETAIL_HNG_DEFER_TRY {
+				co_await body(scope);
+			}
+			DETAIL_HNG_DEFER_CATCH_ALL {
+				scope_exception = std::current_exception();
+			}
+			co_await scope.close(std::move(scope_exception));
+		}
+		else if constexpr (std::is_reference_v<result_type>) {
+			std::remove_reference_t<result_type>* result = nullptr;
+			DETAIL_HNG_DEFER_TRY {
+				result_type value = co_await body(scope);
+				result = std::addressof(value);
+			}
+			DETAIL_HNG_DEFER_CATCH_ALL {
+				scope_exception = std::current_exception();
+			}
+			co_await scope.close(std::move(scope_exception));
+			co_return static_cast<result_type>(*result);
+		}
+		else {
+			std::optional<result_type> result;
+			DETAIL_HNG_DEFER_TRY {
+				result.emplace(co_await body(scope));
+			}
+			DETAIL_HNG_DEFER_CATCH_ALL {
+				scope_exception = std::current_exception();
+			}
+			co_await scope.close(std::move(scope_exception));
+			co_return std::move(*result);
+		}
+	}
+}
+
+#endif // ^^^ DETAIL_HNG_DEFER_HAS_COROUTINES
+
+#endif // ^^^ HNG_CO_DEFER_HEADERGUARD
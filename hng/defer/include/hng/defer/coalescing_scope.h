@@ -0,0 +1,245 @@
+#ifndef HNG_COALESCING_SCOPE_HEADERGUARD
+#define HNG_COALESCING_SCOPE_HEADERGUARD
+//
+//	Licence:	MIT
+//	GitHub:		https://github.com/highestnamegames/defer
+//	Version:	v1.1.0
+//
+//	Summary:
+//		Deferred work which is deduplicated by key until the end of the scope, such as one tick of an event loop.
+//		hng::defer_once(key, callable) defers the callable to the innermost hng::coalescing_scope of the calling thread,
+//		which is reached through a thread-local pointer, so code deep in the call stack needs no parameter.
+//		Only the first callable deferred with a key is kept; the kept callables run once each,
+//		in insertion order, when the scope exits.
+//		Keys are looked up in a small open-addressing table, and callables are stored in an inline buffer
+//		(then in reusable heap chunks), like hng::defer_stack.
+//		Compatible with C++17.
+//
+//	Example:
+//		```
+//			for (;;) {
+//				hng::coalescing_scope tick;
+//				dispatch(poll_events()); // may call hng::defer_once(&file, [&file]()noexcept{ file.flush(); }) many times
+//			} // each file is flushed once
+//		```
+//
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <hng/defer/defer_core.h>
+#include <hng/defer/defer_stack.h>
+
+namespace hng {
+
+	class coalescing_scope;
+
+	namespace detail {
+		namespace coalescing {
+
+			inline coalescing_scope*& current() noexcept {
+				static thread_local coalescing_scope* scope = nullptr;
+				return scope;
+			}
+
+			// Its address identifies a key type.
+			template<class T>
+			struct key_type_tag
+			{
+				static constexpr char value = 0;
+			};
+
+			// A key's value, and its type, so that keys of different types with the same value are different keys.
+			struct key
+			{
+				std::uint64_t m_value;
+				void const* m_type;
+
+				inline bool operator==(key const& other) const noexcept { return m_value == other.m_value && m_type == other.m_type; }
+				inline bool operator!=(key const& other) const noexcept { return !(*this == other); }
+			};
+
+			// Keys are pointers (the object the work applies to), integers or enumerations.
+			// Pointers to the same object are the same key, whatever the cv-qualification of the pointed-to type.
+			template<class Key>
+			inline key key_of(Key const& k) noexcept {
+				if constexpr (std::is_pointer_v<Key>) {
+					using type = std::remove_cv_t<std::remove_pointer_t<Key>>*;
+					return key{ static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(k)), &key_type_tag<type>::value };
+				}
+				else if constexpr (std::is_enum_v<Key>) {
+					return key{ static_cast<std::uint64_t>(static_cast<std::underlying_type_t<Key>>(k)), &key_type_tag<std::remove_cv_t<Key>>::value };
+				}
+				else {
+					static_assert(std::is_integral_v<Key>, "the key must be a pointer, an integer or an enumeration");
+					return key{ static_cast<std::uint64_t>(k), &key_type_tag<std::remove_cv_t<Key>>::value };
+				}
+			}
+
+			// A deferred callable, in insertion order.
+			struct record
+			{
+				key m_key;
+				::hng::detail::defer_stack::entry* m_entry;
+			};
+
+			constexpr std::size_t inline_bytes = 512;
+			constexpr std::size_t inline_records = 16;
+
+		}
+	}
+
+	// Keeps the first callable deferred with each key, and invokes the kept callables once each, in insertion order,
+	// when the scope is destroyed (or run() is called).
+	// While it is alive, the scope is the target of hng::defer_once on the constructing thread;
+	// scopes nest, and the innermost one is the target.
+	// Keys are indexed by a linear probing table which holds the records' indices, and is at most half full;
+	// the records and their table are inline for up to 16 keys, and grow on the heap beyond.
+	class coalescing_scope
+	{
+	private:
+		using record = detail::coalescing::record;
+
+		detail::defer_stack::arena<detail::coalescing::inline_bytes> m_arena;
+		record m_inline_records[detail::coalescing::inline_records];
+		// Index + 1 of the newest record with the slot's key, or 0 for an empty slot.
+		std::uint32_t m_inline_slots[2 * detail::coalescing::inline_records];
+		record* m_records;
+		std::uint32_t* m_slots;
+		std::size_t m_capacity; // records; the table has 2 * m_capacity slots
+		std::size_t m_size;
+		std::size_t m_ran; // the records before m_ran have been invoked by the current run
+		coalescing_scope* m_previous;
+
+		// Fibonacci hashing, so that aligned pointers and consecutive integers spread over the table.
+		inline std::size_t home_slot(detail::coalescing::key const& key) const noexcept {
+			std::size_t const slots = 2 * m_capacity;
+			std::uint64_t const mixed = key.m_value ^ static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(key.m_type));
+			return static_cast<std::size_t>((mixed * 0x9E3779B97F4A7C15ull) >> 32) & (slots - 1);
+		}
+
+		// The slot which holds `key`, or the empty slot where it would be inserted.
+		inline std::uint32_t* find_slot(detail::coalescing::key const& key) const noexcept {
+			std::size_t const mask = 2 * m_capacity - 1;
+			std::size_t i = home_slot(key);
+			while (m_slots[i] != 0 && m_records[m_slots[i] - 1].m_key != key) {
+				i = (i + 1) & mask;
+			}
+			return &m_slots[i];
+		}
+
+		inline void free_heap() noexcept {
+			if (m_records != m_inline_records) {
+				delete[] m_records;
+				delete[] m_slots;
+			}
+		}
+
+		// Doubles the capacity, and rebuilds the table. Leaves the scope unchanged if an allocation throws.
+		inline void grow() {
+			std::size_t const capacity = 2 * m_capacity;
+			record* const records = new record[capacity];
+			std::uint32_t* slots;
+			DETAIL_HNG_DEFER_TRY {
+				slots = new std::uint32_t[2 * capacity]();
+			}
+			DETAIL_HNG_DEFER_CATCH_ALL {
+				delete[] records;
+				DETAIL_HNG_DEFER_RETHROW;
+			}
+			std::memcpy(static_cast<void*>(records), m_records, m_size * sizeof(record));
+			free_heap();
+			m_records = records;
+			m_slots = slots;
+			m_capacity = capacity;
+			for (std::size_t i = 0; i < m_size; ++i) {
+				*find_slot(m_records[i].m_key) = static_cast<std::uint32_t>(i + 1);
+			}
+		}
+
+	public:
+		inline coalescing_scope(coalescing_scope const&) = delete;
+		inline coalescing_scope(coalescing_scope&&) = delete;
+		inline coalescing_scope& operator=(coalescing_scope const&) = delete;
+		inline coalescing_scope& operator=(coalescing_scope&&) = delete;
+
+		inline coalescing_scope() noexcept
+			: m_arena(), m_inline_slots(), m_records(m_inline_records), m_slots(m_inline_slots),
+			m_capacity(detail::coalescing::inline_records), m_size(0), m_ran(0), m_previous(detail::coalescing::current()) {
+			detail::coalescing::current() = this;
+		}
+
+		// Invokes the kept callables, then makes the enclosing scope the target of hng::defer_once again.
+		inline ~coalescing_scope() noexcept {
+			run();
+			detail::coalescing::current() = m_previous;
+			free_heap();
+		}
+
+		// The innermost scope of the calling thread, or nullptr.
+		static inline coalescing_scope* current() noexcept { return detail::coalescing::current(); }
+
+		// Defers the callable, unless a callable deferred with the same key (same value and same type) is still pending.
+		// Returns true if the callable was kept, false if it was coalesced (and destroyed without being invoked).
+		// A key whose callable has already been invoked by the current run() can be deferred again, and then runs again.
+		// If the callable cannot be stored (allocation or construction throws), nothing is deferred and the exception is propagated.
+		template<class Key, class Callable>
+		inline bool defer_once(Key const& key, Callable&& callable) {
+			using F = std::decay_t<Callable>;
+			static_assert(noexcept(std::declval<F&&>()()), "the deferred callable must be noexcept");
+			static_assert(alignof(F) <= alignof(std::max_align_t), "over-aligned callables are not supported");
+
+			detail::coalescing::key const k = detail::coalescing::key_of(key);
+			std::uint32_t* slot = find_slot(k);
+			if (*slot != 0 && *slot - 1 >= m_ran)
+				return false;
+			if (m_size == m_capacity) {
+				grow();
+				slot = find_slot(k);
+			}
+
+			detail::defer_stack::entry* const e = detail::defer_stack::push_entry(m_arena, nullptr, std::forward<Callable>(callable));
+			m_records[m_size] = record{ k, e };
+			*slot = static_cast<std::uint32_t>(m_size + 1);
+			++m_size;
+			return true;
+		}
+
+		// Invokes the kept callables now, in insertion order, including those they defer to this scope,
+		// and empties the scope; the heap storage is kept for the next run.
+		inline void run() noexcept {
+			if (m_size == 0)
+				return;
+			while (m_ran < m_size) {
+				detail::defer_stack::entry* const e = m_records[m_ran].m_entry;
+				++m_ran;
+				e->m_fn(e, true);
+			}
+			std::memset(m_slots, 0, 2 * m_capacity * sizeof(std::uint32_t));
+			m_size = 0;
+			m_ran = 0;
+			m_arena.reset();
+		}
+
+		// The number of callables which have not run yet.
+		inline std::size_t size() const noexcept { return m_size - m_ran; }
+		inline bool empty() const noexcept { return m_size == m_ran; }
+	};
+
+	// Defers the callable to the innermost hng::coalescing_scope of the calling thread, unless a callable
+	// with the same key is pending there (see coalescing_scope::defer_once).
+	// Without a scope, the callable is invoked immediately, and true is returned.
+	template<class Key, class Callable>
+	inline bool defer_once(Key const& key, Callable&& callable) {
+		if (coalescing_scope* const scope = coalescing_scope::current())
+			return scope->defer_once(key, std::forward<Callable>(callable));
+		std::decay_t<Callable> local(std::forward<Callable>(callable));
+		std::move(local)();
+		return true;
+	}
+}
+
+#endif // ^^^ HNG_COALESCING_SCOPE_HEADERGUARD
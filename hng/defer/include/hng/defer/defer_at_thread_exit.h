@@ -0,0 +1,190 @@
+#ifndef HNG_DEFER_AT_THREAD_EXIT_HEADERGUARD
+#define HNG_DEFER_AT_THREAD_EXIT_HEADERGUARD
+//
+//	Licence:	MIT
+//	GitHub:		https://github.com/highestnamegames/defer
+//	Version:	v1.1.0
+//
+//	Summary:
+//		Defers a callable to the exit of the calling thread.
+//		Callables are kept in a per-thread intrusive list, without locks,
+//		and callables are bump allocated in a per-thread inline buffer (then in heap chunks).
+//		On thread exit the callables run in reverse order of registration.
+//		Compatible with C++17.
+//
+//	Example:
+//		```
+//			struct worker_cache { /* trivially destructible */ };
+//			static thread_local worker_cache* cache = nullptr;
+//			if (!cache) {
+//				cache = new worker_cache();
+//				hng::defer_at_thread_exit([]()noexcept{ delete cache; cache = nullptr; });
+//			}
+//		```
+//
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <hng/defer/defer_core.h>
+
+namespace hng {
+	namespace detail {
+		namespace thread_exit {
+
+			struct entry
+			{
+				entry* m_prev;
+				// Invokes the callable and releases the entry.
+				void (*m_run)(entry*) noexcept;
+			};
+
+			template<class Callable>
+			struct callable_entry : entry
+			{
+				Callable m_callable;
+
+				template<class C>
+				inline explicit callable_entry(C&& callable, void (*run)(entry*) noexcept) : entry{ nullptr, run }, m_callable(std::forward<C>(callable)) {}
+
+				static inline void run_inline(entry* e) noexcept {
+					callable_entry* const self = static_cast<callable_entry*>(e);
+					std::move(self->m_callable)();
+					self->~callable_entry();
+				}
+
+				static inline void run_heap(entry* e) noexcept {
+					callable_entry* const self = static_cast<callable_entry*>(e);
+					std::move(self->m_callable)();
+					delete self;
+				}
+			};
+
+			constexpr std::size_t inline_bytes = 512;
+			constexpr std::size_t chunk_bytes = 4096;
+
+			// Heap storage used once the inline buffer is full. Freed after the exit callables have run.
+			struct alignas(std::max_align_t) chunk
+			{
+				chunk* m_prev;
+				std::size_t m_capacity;
+
+				inline unsigned char* data() noexcept { return reinterpret_cast<unsigned char*>(this + 1); }
+			};
+
+			// Trivially constructible and destructible, so that accessing it needs no TLS guard.
+			struct thread_state
+			{
+				entry* m_head;
+				// The newest chunk, or null while the inline buffer is in use.
+				chunk* m_chunk;
+				std::size_t m_used;
+				bool m_hook_registered;
+				bool m_exited;
+				alignas(std::max_align_t) unsigned char m_buffer[inline_bytes];
+			};
+
+			inline thread_state& state() noexcept {
+				static thread_local thread_state s;
+				return s;
+			}
+
+			// Bump allocates `size` bytes aligned to `align` (at most alignof(std::max_align_t)).
+			inline void* allocate(thread_state& s, std::size_t size, std::size_t align) {
+				unsigned char* data = s.m_chunk ? s.m_chunk->data() : s.m_buffer;
+				std::size_t const capacity = s.m_chunk ? s.m_chunk->m_capacity : inline_bytes;
+				std::size_t offset = (s.m_used + align - 1) & ~(align - 1);
+				if (offset + size > capacity) {
+					std::size_t const new_capacity = size > chunk_bytes ? size : chunk_bytes;
+					chunk* const c = static_cast<chunk*>(::operator new(sizeof(chunk) + new_capacity));
+					c->m_prev = s.m_chunk;
+					c->m_capacity = new_capacity;
+					s.m_chunk = c;
+					data = c->data();
+					offset = 0;
+				}
+				s.m_used = offset + size;
+				return data + offset;
+			}
+
+			inline void run_all(thread_state& s) noexcept {
+				while (entry* const e = s.m_head) {
+					s.m_head = e->m_prev;
+					e->m_run(e);
+				}
+				while (chunk* const c = s.m_chunk) {
+					s.m_chunk = c->m_prev;
+					::operator delete(c);
+				}
+				s.m_used = 0;
+			}
+
+			struct exit_hook
+			{
+				inline ~exit_hook() noexcept {
+					thread_state& s = state();
+					run_all(s);
+					s.m_exited = true;
+				}
+			};
+
+			// The only thread_local with a destructor; touched once per thread.
+			inline void register_exit_hook(thread_state& s) {
+				static thread_local exit_hook hook;
+				static_cast<void>(hook);
+				s.m_hook_registered = true;
+			}
+
+		}
+	}
+
+	// Invokes the callable when the calling thread exits, after the callables registered later.
+	// Callables are stored in a per-thread inline buffer of 512 bytes, and then in 4 KiB heap chunks,
+	// so registering small callables only allocates once per chunk.
+	// Callables registered after the thread's exit callables have run (for example by the destructor
+	// of another thread_local object) are invoked immediately.
+	// Throws std::bad_alloc if a chunk cannot be allocated, or whatever copying/moving the callable throws.
+	template<class Callable>
+	#if (defined(__cpp_concepts) && __cpp_concepts >= 201907L)
+	requires (noexcept(std::declval<std::decay_t<Callable>&&>()()))
+	#endif
+	inline void defer_at_thread_exit(Callable&& callable) {
+		using entry_type = detail::thread_exit::callable_entry<std::decay_t<Callable>>;
+		detail::thread_exit::thread_state& s = detail::thread_exit::state();
+		if (s.m_exited) {
+			std::decay_t<Callable> local(std::forward<Callable>(callable));
+			std::move(local)();
+			return;
+		}
+		if (!s.m_hook_registered) {
+			detail::thread_exit::register_exit_hook(s);
+		}
+		entry_type* e;
+		if constexpr (alignof(entry_type) <= alignof(std::max_align_t)) {
+			std::size_t const used = s.m_used;
+			detail::thread_exit::chunk* const chunk = s.m_chunk;
+			void* const storage = detail::thread_exit::allocate(s, sizeof(entry_type), alignof(entry_type));
+			DETAIL_HNG_DEFER_TRY {
+				e = ::new (storage) entry_type(std::forward<Callable>(callable), &entry_type::run_inline);
+			}
+			DETAIL_HNG_DEFER_CATCH_ALL {
+				// A chunk allocated for the entry stays for the next registration.
+				if (s.m_chunk == chunk) {
+					s.m_used = used;
+				}
+				else {
+					s.m_used = 0;
+				}
+				DETAIL_HNG_DEFER_RETHROW;
+			}
+		}
+		else {
+			e = new entry_type(std::forward<Callable>(callable), &entry_type::run_heap);
+		}
+		e->m_prev = s.m_head;
+		s.m_head = e;
+	}
+}
+
+#endif // ^^^ HNG_DEFER_AT_THREAD_EXIT_HEADERGUARD
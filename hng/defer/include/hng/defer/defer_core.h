@@ -0,0 +1,330 @@
+#ifndef HNG_DEFER_CORE_HEADERGUARD
+#define HNG_DEFER_CORE_HEADERGUARD
+//
+//	Licence:	MIT
+//	GitHub:		https://github.com/highestnamegames/defer
+//	Version:	v1.1.0
+//
+//	Summary:
+//		The core of <hng/defer/defer.h>: hng::defer, hng::defer_on_fail, hng::defer_on_success
+//		and the HNG_DEFER_* macros, without the HNG_DT_* macros and the exception types.
+//		Only includes <exception>, <utility> and <type_traits>, so it is cheap to include in every translation unit.
+//		Compatible with C++11, C++14, C++17.
+//		In C++20, hng::defer, hng::defer_on_fail and hng::defer_on_success are usable in constant evaluation.
+//
+
+#include <exception>
+#include <utility>
+#include <type_traits>
+
+#if ((__cplusplus >= 201703L) || (defined(_MSVC_LANG) && (_MSVC_LANG >= 201703L) && (_MSC_VER >= 1913)))
+#define DETAIL_HNG_DEFER_HAS_CPP17 1
+#else
+#define DETAIL_HNG_DEFER_HAS_CPP17 0
+#endif
+
+#if DETAIL_HNG_DEFER_HAS_CPP17
+#define DETAIL_HNG_DEFER_CONSTEXPR_VAR constexpr
+#else
+#define DETAIL_HNG_DEFER_CONSTEXPR_VAR
+#endif
+
+#if DETAIL_HNG_DEFER_HAS_CPP17
+#define DETAIL_HNG_DEFER_CONSTEXPR_IF constexpr
+#else
+#define DETAIL_HNG_DEFER_CONSTEXPR_IF
+#endif
+
+#if (defined(_MSC_VER) && !defined(__clang__))
+#define DETAIL_HNG_DEFER_MSVC_PRAGMA(x) _Pragma(x)
+#else
+#define DETAIL_HNG_DEFER_MSVC_PRAGMA(x)
+#endif
+
+#if (DETAIL_HNG_DEFER_HAS_CPP17 || (defined(__cpp_lib_uncaught_exceptions) && __cpp_lib_uncaught_exceptions >= 201411L))
+#define DETAIL_HNG_DEFER_HAS_UNCAUGHT_EXCEPTIONS 1
+#else
+#define DETAIL_HNG_DEFER_HAS_UNCAUGHT_EXCEPTIONS 0
+#endif
+
+#if (defined(__cpp_exceptions) || defined(__EXCEPTIONS) || (defined(_MSC_VER) && defined(_CPPUNWIND)))
+#define DETAIL_HNG_DEFER_HAS_EXCEPTIONS 1
+#else
+#define DETAIL_HNG_DEFER_HAS_EXCEPTIONS 0
+#endif
+
+// Exception handling which compiles away in builds without exceptions (-fno-exceptions, /EHs-c-):
+// the try block becomes a plain block, the catch block is discarded, and throwing terminates.
+#if DETAIL_HNG_DEFER_HAS_EXCEPTIONS
+#define DETAIL_HNG_DEFER_TRY try
+#define DETAIL_HNG_DEFER_CATCH_ALL catch(...)
+#define DETAIL_HNG_DEFER_RETHROW throw
+#define DETAIL_HNG_DEFER_THROW(exception) throw exception
+#else
+#define DETAIL_HNG_DEFER_TRY if(true)
+#define DETAIL_HNG_DEFER_CATCH_ALL else
+#define DETAIL_HNG_DEFER_RETHROW ::std::terminate()
+#define DETAIL_HNG_DEFER_THROW(exception) ::std::terminate()
+#endif
+
+// Constexpr destructors, and try blocks in constexpr functions (C++20):
+// hng::defer and the non-throwing path of the HNG_DT constructs can then be evaluated at compile time.
+#if (defined(__cpp_constexpr) && __cpp_constexpr >= 201907L && defined(__cpp_lib_is_constant_evaluated) && __cpp_lib_is_constant_evaluated >= 201811L)
+#define DETAIL_HNG_DEFER_HAS_CPP20_CONSTEXPR 1
+#define DETAIL_HNG_DEFER_CONSTEXPR20 constexpr
+#else
+#define DETAIL_HNG_DEFER_HAS_CPP20_CONSTEXPR 0
+#define DETAIL_HNG_DEFER_CONSTEXPR20
+#endif
+
+#if defined(HNG_DEFER_INSTRUMENT)
+#if !DETAIL_HNG_DEFER_HAS_CPP17
+#error HNG_DEFER_INSTRUMENT requires C++17
+#endif
+#include <hng/defer/defer_instrument.h>
+#endif
+
+namespace hng {
+	template<class Callable>
+	#if (defined(__cpp_concepts) && __cpp_concepts >= 201907L)
+	requires (noexcept(std::declval<Callable&&>()()))
+	#endif
+	struct defer
+	{
+	private:
+		Callable m_callable;
+	public:
+		inline DETAIL_HNG_DEFER_CONSTEXPR20 ~defer() noexcept { std::move(m_callable)(); }
+		inline defer(defer const&) = delete;
+		inline defer(defer&&) = delete;
+		inline defer& operator=(defer const&) = delete;
+		inline defer& operator=(defer&&) = delete;
+		inline DETAIL_HNG_DEFER_CONSTEXPR20 defer() noexcept(std::is_nothrow_default_constructible_v<Callable>) : m_callable() {}
+		inline DETAIL_HNG_DEFER_CONSTEXPR20 explicit defer(Callable&& callable) noexcept(std::is_nothrow_move_constructible_v<Callable>) : m_callable(std::move(callable)) {}
+		inline DETAIL_HNG_DEFER_CONSTEXPR20 explicit defer(Callable const& callable) noexcept(std::is_nothrow_copy_constructible_v<Callable>) : m_callable(callable) {}
+	};
+
+#if DETAIL_HNG_DEFER_HAS_UNCAUGHT_EXCEPTIONS
+
+	namespace detail {
+		namespace defer {
+
+			// std::uncaught_exceptions(), which is 0 during constant evaluation, since nothing can be thrown there.
+			inline DETAIL_HNG_DEFER_CONSTEXPR20 int uncaught_exceptions() noexcept {
+#if DETAIL_HNG_DEFER_HAS_CPP20_CONSTEXPR
+				if (std::is_constant_evaluated())
+					return 0;
+#endif // ^^^ DETAIL_HNG_DEFER_HAS_CPP20_CONSTEXPR
+				return std::uncaught_exceptions();
+			}
+
+		}
+	}
+
+	// Invokes the callable at the end of the scope only if the scope is exited by an exception.
+	// Failure is detected by comparing std::uncaught_exceptions() at construction and destruction,
+	// so no try/catch is involved.
+	template<class Callable>
+	#if (defined(__cpp_concepts) && __cpp_concepts >= 201907L)
+	requires (noexcept(std::declval<Callable&&>()()))
+	#endif
+	struct defer_on_fail
+	{
+	private:
+		Callable m_callable;
+		int m_uncaught_exceptions;
+	public:
+		inline DETAIL_HNG_DEFER_CONSTEXPR20 ~defer_on_fail() noexcept { if (detail::defer::uncaught_exceptions() > m_uncaught_exceptions) { std::move(m_callable)(); } }
+		inline defer_on_fail(defer_on_fail const&) = delete;
+		inline defer_on_fail(defer_on_fail&&) = delete;
+		inline defer_on_fail& operator=(defer_on_fail const&) = delete;
+		inline defer_on_fail& operator=(defer_on_fail&&) = delete;
+		inline DETAIL_HNG_DEFER_CONSTEXPR20 defer_on_fail() noexcept(std::is_nothrow_default_constructible_v<Callable>) : m_callable(), m_uncaught_exceptions(detail::defer::uncaught_exceptions()) {}
+		inline DETAIL_HNG_DEFER_CONSTEXPR20 explicit defer_on_fail(Callable&& callable) noexcept(std::is_nothrow_move_constructible_v<Callable>) : m_callable(std::move(callable)), m_uncaught_exceptions(detail::defer::uncaught_exceptions()) {}
+		inline DETAIL_HNG_DEFER_CONSTEXPR20 explicit defer_on_fail(Callable const& callable) noexcept(std::is_nothrow_copy_constructible_v<Callable>) : m_callable(callable), m_uncaught_exceptions(detail::defer::uncaught_exceptions()) {}
+	};
+
+
+	// Invokes the callable at the end of the scope only if the scope is exited normally (not by an exception).
+	template<class Callable>
+	#if (defined(__cpp_concepts) && __cpp_concepts >= 201907L)
+	requires (noexcept(std::declval<Callable&&>()()))
+	#endif
+	struct defer_on_success
+	{
+	private:
+		Callable m_callable;
+		int m_uncaught_exceptions;
+	public:
+		inline DETAIL_HNG_DEFER_CONSTEXPR20 ~defer_on_success() noexcept { if (detail::defer::uncaught_exceptions() <= m_uncaught_exceptions) { std::move(m_callable)(); } }
+		inline defer_on_success(defer_on_success const&) = delete;
+		inline defer_on_success(defer_on_success&&) = delete;
+		inline defer_on_success& operator=(defer_on_success const&) = delete;
+		inline defer_on_success& operator=(defer_on_success&&) = delete;
+		inline DETAIL_HNG_DEFER_CONSTEXPR20 defer_on_success() noexcept(std::is_nothrow_default_constructible_v<Callable>) : m_callable(), m_uncaught_exceptions(detail::defer::uncaught_exceptions()) {}
+		inline DETAIL_HNG_DEFER_CONSTEXPR20 explicit defer_on_success(Callable&& callable) noexcept(std::is_nothrow_move_constructible_v<Callable>) : m_callable(std::move(callable)), m_uncaught_exceptions(detail::defer::uncaught_exceptions()) {}
+		inline DETAIL_HNG_DEFER_CONSTEXPR20 explicit defer_on_success(Callable const& callable) noexcept(std::is_nothrow_copy_constructible_v<Callable>) : m_callable(callable), m_uncaught_exceptions(detail::defer::uncaught_exceptions()) {}
+	};
+
+#endif // ^^^ DETAIL_HNG_DEFER_HAS_UNCAUGHT_EXCEPTIONS
+}
+
+
+
+
+#define DETAIL_HNG_DEFER_CAT_IMPL(a, b) a ## b
+#define DETAIL_HNG_DEFER_CAT(a, b) DETAIL_HNG_DEFER_CAT_IMPL(a, b)
+#define DETAIL_HNG_DEFER_LINEGENNAME DETAIL_HNG_DEFER_CAT(line, __LINE__)
+
+
+#if defined(HNG_DEFER_INSTRUMENT)
+
+// Each macro site declares a constant initialized `site` (file and line),
+// and its callable is wrapped in a `timed` callable which records every run of the cleanup.
+#define DETAIL_HNG_DEFER_SITE(name)\
+	static ::hng::detail::defer_instrument::site DETAIL_HNG_DEFER_CAT(HNG_DEFER_site_,name)(__FILE__,__LINE__);
+
+#define DETAIL_HNG_DEFER_SITE_TYPE(callable_type)\
+	::hng::detail::defer_instrument::timed<::std::decay_t<callable_type>>
+
+#define DETAIL_HNG_DEFER_SITE_VALUE_BEGIN(name)\
+	::hng::detail::defer_instrument::make_timed(DETAIL_HNG_DEFER_CAT(HNG_DEFER_site_,name),
+
+#define DETAIL_HNG_DEFER_SITE_VALUE_END\
+	)
+
+#define DETAIL_HNG_DEFER_SITE_CAUGHT(callable_variable,caught)\
+	::hng::detail::defer_instrument::mark_caught(callable_variable,caught);
+
+#else // ^^^ HNG_DEFER_INSTRUMENT
+
+// Without HNG_DEFER_INSTRUMENT the site macros expand to nothing (or to the callable type unchanged),
+// so the macros produce exactly the same code as without instrumentation support.
+#define DETAIL_HNG_DEFER_SITE(name)
+#define DETAIL_HNG_DEFER_SITE_TYPE(callable_type) callable_type
+#define DETAIL_HNG_DEFER_SITE_VALUE_BEGIN(name)
+#define DETAIL_HNG_DEFER_SITE_VALUE_END
+#define DETAIL_HNG_DEFER_SITE_CAUGHT(callable_variable,caught)
+
+#endif // ^^^ !HNG_DEFER_INSTRUMENT
+
+
+/*	Example:
+	```
+		int* raw_ptr = new int(5);
+		HNG_DEFER_NAMED_BEGIN(random_name)
+		{
+			delete raw_ptr;
+			raw_ptr = nullptr;
+		}
+		HNG_DEFER_NAMED_END(random_name);
+		// ... do stuff with raw_ptr ...
+	```
+*/
+#define HNG_DEFER_NAMED_BEGIN(name)\
+	DETAIL_HNG_DEFER_SITE(name)auto DETAIL_HNG_DEFER_CAT(HNG_DEFER_fn_,name)=[&]()noexcept{
+
+
+#define DETAIL_HNG_DEFER_NAMED_END(defer_template,name)\
+	};::hng::defer_template<DETAIL_HNG_DEFER_SITE_TYPE(decltype(DETAIL_HNG_DEFER_CAT(HNG_DEFER_fn_,name)))>DETAIL_HNG_DEFER_CAT(HNG_DEFER_var_,name)(DETAIL_HNG_DEFER_SITE_VALUE_BEGIN(name)::std::move(DETAIL_HNG_DEFER_CAT(HNG_DEFER_fn_,name))DETAIL_HNG_DEFER_SITE_VALUE_END);do{}while(0)
+
+
+#define DETAIL_HNG_DEFER_CALLABLE_VARIABLE(defer_template,callable_variable)\
+	DETAIL_HNG_DEFER_SITE(DETAIL_HNG_DEFER_LINEGENNAME)hng::defer_template<DETAIL_HNG_DEFER_SITE_TYPE(decltype(callable_variable))> const DETAIL_HNG_DEFER_CAT(HNG_DEFER_var_,DETAIL_HNG_DEFER_LINEGENNAME) (DETAIL_HNG_DEFER_SITE_VALUE_BEGIN(DETAIL_HNG_DEFER_LINEGENNAME)::std::move(callable_variable)DETAIL_HNG_DEFER_SITE_VALUE_END);
+
+
+#define HNG_DEFER_NAMED_END(name)\
+	DETAIL_HNG_DEFER_NAMED_END(defer,name)
+
+
+#define HNG_DEFER_BLOCK(...)\
+	HNG_DEFER_NAMED_BEGIN(DETAIL_HNG_DEFER_LINEGENNAME){__VA_ARGS__}HNG_DEFER_NAMED_END(DETAIL_HNG_DEFER_LINEGENNAME)
+
+
+#define HNG_DEFER_CALLABLE_VARIABLE(callable_variable)\
+	DETAIL_HNG_DEFER_CALLABLE_VARIABLE(defer,callable_variable)
+
+
+
+#if DETAIL_HNG_DEFER_HAS_CPP17
+
+
+#define DETAIL_HNG_DEFER_BEGIN(defer_template)\
+	DETAIL_HNG_DEFER_SITE(DETAIL_HNG_DEFER_LINEGENNAME)auto const DETAIL_HNG_DEFER_CAT(HNG_DEFER_var_,DETAIL_HNG_DEFER_LINEGENNAME)=::hng::defer_template(DETAIL_HNG_DEFER_SITE_VALUE_BEGIN(DETAIL_HNG_DEFER_LINEGENNAME)[&]()noexcept{
+
+
+#define HNG_DEFER_BEGIN\
+	DETAIL_HNG_DEFER_BEGIN(defer)
+
+
+#define HNG_DEFER_END\
+	}DETAIL_HNG_DEFER_SITE_VALUE_END);do{}while(0)
+
+
+#endif // ^^^ DETAIL_HNG_DEFER_HAS_CPP17
+
+
+
+#if DETAIL_HNG_DEFER_HAS_UNCAUGHT_EXCEPTIONS
+
+
+// Same as the HNG_DEFER_* macros, except the block is only executed if the scope is exited by an exception.
+#define HNG_DEFER_ON_FAIL_NAMED_BEGIN(name)\
+	HNG_DEFER_NAMED_BEGIN(name)
+
+
+#define HNG_DEFER_ON_FAIL_NAMED_END(name)\
+	DETAIL_HNG_DEFER_NAMED_END(defer_on_fail,name)
+
+
+#define HNG_DEFER_ON_FAIL_BLOCK(...)\
+	HNG_DEFER_ON_FAIL_NAMED_BEGIN(DETAIL_HNG_DEFER_LINEGENNAME){__VA_ARGS__}HNG_DEFER_ON_FAIL_NAMED_END(DETAIL_HNG_DEFER_LINEGENNAME)
+
+
+#define HNG_DEFER_ON_FAIL_CALLABLE_VARIABLE(callable_variable)\
+	DETAIL_HNG_DEFER_CALLABLE_VARIABLE(defer_on_fail,callable_variable)
+
+
+// Same as the HNG_DEFER_* macros, except the block is only executed if the scope is exited normally.
+#define HNG_DEFER_ON_SUCCESS_NAMED_BEGIN(name)\
+	HNG_DEFER_NAMED_BEGIN(name)
+
+
+#define HNG_DEFER_ON_SUCCESS_NAMED_END(name)\
+	DETAIL_HNG_DEFER_NAMED_END(defer_on_success,name)
+
+
+#define HNG_DEFER_ON_SUCCESS_BLOCK(...)\
+	HNG_DEFER_ON_SUCCESS_NAMED_BEGIN(DETAIL_HNG_DEFER_LINEGENNAME){__VA_ARGS__}HNG_DEFER_ON_SUCCESS_NAMED_END(DETAIL_HNG_DEFER_LINEGENNAME)
+
+
+#define HNG_DEFER_ON_SUCCESS_CALLABLE_VARIABLE(callable_variable)\
+	DETAIL_HNG_DEFER_CALLABLE_VARIABLE(defer_on_success,callable_variable)
+
+
+#if DETAIL_HNG_DEFER_HAS_CPP17
+
+
+#define HNG_DEFER_ON_FAIL_BEGIN\
+	DETAIL_HNG_DEFER_BEGIN(defer_on_fail)
+
+
+#define HNG_DEFER_ON_FAIL_END\
+	HNG_DEFER_END
+
+
+#define HNG_DEFER_ON_SUCCESS_BEGIN\
+	DETAIL_HNG_DEFER_BEGIN(defer_on_success)
+
+
+#define HNG_DEFER_ON_SUCCESS_END\
+	HNG_DEFER_END
+
+
+#endif // ^^^ DETAIL_HNG_DEFER_HAS_CPP17
+
+
+#endif // ^^^ DETAIL_HNG_DEFER_HAS_UNCAUGHT_EXCEPTIONS
+
+
+#endif // ^^^ HNG_DEFER_CORE_HEADERGUARD
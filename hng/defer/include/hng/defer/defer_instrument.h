@@ -0,0 +1,288 @@
+#ifndef HNG_DEFER_INSTRUMENT_HEADERGUARD
+#define HNG_DEFER_INSTRUMENT_HEADERGUARD
+//
+//	Licence:	MIT
+//	GitHub:		https://github.com/highestnamegames/defer
+//	Version:	v1.1.0
+//
+//	Summary:
+//		Per source location statistics for the defer macros, enabled by defining HNG_DEFER_INSTRUMENT
+//		before including <hng/defer/defer.h> (preferably for the whole program).
+//		Each HNG_DEFER_* and HNG_DT_* macro site records how many times its cleanup ran,
+//		the total and maximum nanoseconds spent in it, and how many of the runs were caused by an exception.
+//		Counters are per thread, and are only written by their own thread.
+//		When HNG_DEFER_INSTRUMENT is not defined, the macros expand exactly as before.
+//		Compatible with C++17.
+//
+//	Example:
+//		```
+//			// g++ -DHNG_DEFER_INSTRUMENT ...
+//			hng::defer_instrument::dump(std::cerr);
+//		```
+//
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <ostream>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <hng/defer/defer_at_thread_exit.h>
+
+namespace hng {
+	namespace defer_instrument {
+
+		struct site_stats
+		{
+			char const* file;
+			unsigned line;
+			std::uint64_t runs;
+			std::uint64_t total_ns;
+			std::uint64_t max_ns;
+			std::uint64_t exceptional_runs;
+		};
+
+	}
+
+	namespace detail {
+		namespace defer_instrument {
+
+			// A macro site. Constant initialized, so declaring it at block scope needs no guard;
+			// its id is assigned when it first records a run.
+			struct site
+			{
+				char const* m_file;
+				unsigned m_line;
+				std::atomic<std::size_t> m_id{ 0 };
+
+				inline constexpr site(char const* file, unsigned line) noexcept : m_file(file), m_line(line) {}
+			};
+
+			struct counters
+			{
+				std::atomic<std::uint64_t> m_runs{ 0 };
+				std::atomic<std::uint64_t> m_total_ns{ 0 };
+				std::atomic<std::uint64_t> m_max_ns{ 0 };
+				std::atomic<std::uint64_t> m_exceptional_runs{ 0 };
+			};
+
+			constexpr std::size_t chunk_size = 256;
+			constexpr std::size_t max_chunks = 64;
+
+			// The counters of one thread, indexed by site id - 1, in chunks which are never moved.
+			struct thread_counters
+			{
+				std::atomic<counters*> m_chunks[max_chunks]{};
+
+				inline ~thread_counters() noexcept {
+					for (auto& chunk : m_chunks) {
+						delete[] chunk.load(std::memory_order_relaxed);
+					}
+				}
+
+				inline counters* find(std::size_t index) const noexcept {
+					counters* const chunk = m_chunks[index / chunk_size].load(std::memory_order_acquire);
+					return chunk ? chunk + index % chunk_size : nullptr;
+				}
+			};
+
+			struct registry
+			{
+				std::mutex m_mutex;
+				std::vector<site const*> m_sites;
+				std::vector<thread_counters*> m_threads;
+				// Totals of the threads which have exited.
+				std::vector<::hng::defer_instrument::site_stats> m_retired;
+			};
+
+			// Never destroyed, so that threads exiting during static destruction can still retire their counters.
+			inline registry& get_registry() {
+				static registry* const r = new registry();
+				return *r;
+			}
+
+			inline std::size_t register_site(site& s) {
+				registry& r = get_registry();
+				std::lock_guard<std::mutex> const lock(r.m_mutex);
+				std::size_t id = s.m_id.load(std::memory_order_relaxed);
+				if (id == 0) {
+					r.m_sites.push_back(&s);
+					r.m_retired.push_back(::hng::defer_instrument::site_stats{ s.m_file, s.m_line, 0, 0, 0, 0 });
+					id = r.m_sites.size();
+					s.m_id.store(id, std::memory_order_release);
+				}
+				return id;
+			}
+
+			inline void add(::hng::defer_instrument::site_stats& total, counters const& c) noexcept {
+				total.runs += c.m_runs.load(std::memory_order_relaxed);
+				total.total_ns += c.m_total_ns.load(std::memory_order_relaxed);
+				total.max_ns = (std::max)(total.max_ns, c.m_max_ns.load(std::memory_order_relaxed));
+				total.exceptional_runs += c.m_exceptional_runs.load(std::memory_order_relaxed);
+			}
+
+			inline void retire_thread(thread_counters* tc) noexcept {
+				registry& r = get_registry();
+				{
+					std::lock_guard<std::mutex> const lock(r.m_mutex);
+					for (std::size_t i = 0; i < r.m_sites.size(); ++i) {
+						if (counters const* const c = tc->find(i)) {
+							add(r.m_retired[i], *c);
+						}
+					}
+					r.m_threads.erase(std::find(r.m_threads.begin(), r.m_threads.end(), tc));
+				}
+				delete tc;
+			}
+
+			inline thread_counters* current_thread() {
+				static thread_local thread_counters* tc = nullptr;
+				if (!tc) {
+					thread_counters* const created = new thread_counters();
+					{
+						registry& r = get_registry();
+						std::lock_guard<std::mutex> const lock(r.m_mutex);
+						r.m_threads.push_back(created);
+					}
+					tc = created;
+					// Runs immediately (leaving tc null) if the thread's exit callables have already run.
+					::hng::defer_at_thread_exit([]() noexcept {
+						retire_thread(tc);
+						tc = nullptr;
+					});
+				}
+				return tc;
+			}
+
+			inline counters* slot(site& s) {
+				std::size_t id = s.m_id.load(std::memory_order_acquire);
+				if (id == 0) {
+					id = register_site(s);
+				}
+				std::size_t const index = id - 1;
+				if (index / chunk_size >= max_chunks)
+					return nullptr;
+				thread_counters* const tc = current_thread();
+				if (!tc)
+					return nullptr;
+				std::atomic<counters*>& chunk = tc->m_chunks[index / chunk_size];
+				counters* c = chunk.load(std::memory_order_relaxed);
+				if (!c) {
+					c = new counters[chunk_size];
+					chunk.store(c, std::memory_order_release);
+				}
+				return c + index % chunk_size;
+			}
+
+			// Single writer: plain load and store, no read-modify-write.
+			inline void bump(std::atomic<std::uint64_t>& counter, std::uint64_t value) noexcept {
+				counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+			}
+
+			inline void record(site& s, std::uint64_t ns, bool exceptional) noexcept {
+				counters* c;
+				DETAIL_HNG_DEFER_TRY {
+					c = slot(s);
+				}
+				DETAIL_HNG_DEFER_CATCH_ALL {
+					return;
+				}
+				if (!c)
+					return;
+				bump(c->m_runs, 1);
+				bump(c->m_total_ns, ns);
+				if (ns > c->m_max_ns.load(std::memory_order_relaxed)) {
+					c->m_max_ns.store(ns, std::memory_order_relaxed);
+				}
+				if (exceptional) {
+					bump(c->m_exceptional_runs, 1);
+				}
+			}
+
+			// Wraps the callable of a macro site, and records each invocation.
+			// A run is exceptional if it happens during stack unwinding,
+			// or if the DT macros invoke it from their catch block.
+			template<class Callable>
+			struct timed
+			{
+				Callable m_callable;
+				site& m_site;
+				int m_uncaught_exceptions;
+				bool m_caught;
+
+				template<class F>
+				inline timed(site& s, F&& callable) noexcept(std::is_nothrow_constructible<Callable, F&&>::value)
+					: m_callable(std::forward<F>(callable)), m_site(s), m_uncaught_exceptions(std::uncaught_exceptions()), m_caught(false) {}
+
+				inline decltype(auto) operator()() && noexcept(noexcept(std::declval<Callable&&>()())) {
+					using clock = std::chrono::steady_clock;
+					struct recorder
+					{
+						site& m_site;
+						bool m_exceptional;
+						clock::time_point m_start;
+						inline ~recorder() noexcept {
+							auto const ns = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - m_start).count();
+							record(m_site, static_cast<std::uint64_t>(ns), m_exceptional);
+						}
+					} const r{ m_site, m_caught || std::uncaught_exceptions() > m_uncaught_exceptions, clock::now() };
+					return std::move(m_callable)();
+				}
+			};
+
+			template<class Callable>
+			inline timed<std::decay_t<Callable>> make_timed(site& s, Callable&& callable) noexcept(std::is_nothrow_constructible<std::decay_t<Callable>, Callable>::value) {
+				return timed<std::decay_t<Callable>>(s, std::forward<Callable>(callable));
+			}
+
+			template<class Callable>
+			inline void mark_caught(timed<Callable>& t, bool caught) noexcept {
+				t.m_caught = caught;
+			}
+
+		}
+	}
+
+	namespace defer_instrument {
+
+		// The statistics of every site which has run, summed over all threads, including those which have exited.
+		// Counters of running threads are read without stopping them, so a snapshot may lag slightly behind.
+		inline std::vector<site_stats> snapshot() {
+			detail::defer_instrument::registry& r = detail::defer_instrument::get_registry();
+			std::lock_guard<std::mutex> const lock(r.m_mutex);
+			std::vector<site_stats> stats = r.m_retired;
+			for (detail::defer_instrument::thread_counters const* const tc : r.m_threads) {
+				for (std::size_t i = 0; i < stats.size(); ++i) {
+					if (detail::defer_instrument::counters const* const c = tc->find(i)) {
+						detail::defer_instrument::add(stats[i], *c);
+					}
+				}
+			}
+			return stats;
+		}
+
+		// Writes one line per site, the most expensive (total time) first.
+		inline void dump(std::ostream& os) {
+			std::vector<site_stats> stats = snapshot();
+			std::sort(stats.begin(), stats.end(), [](site_stats const& a, site_stats const& b) { return a.total_ns > b.total_ns; });
+			for (site_stats const& s : stats) {
+				os << s.file << ':' << s.line
+					<< " runs=" << s.runs
+					<< " total_ns=" << s.total_ns
+					<< " max_ns=" << s.max_ns
+					<< " mean_ns=" << (s.runs ? s.total_ns / s.runs : 0)
+					<< " exceptional_runs=" << s.exceptional_runs
+					<< '\n';
+			}
+		}
+
+	}
+}
+
+
+#endif // ^^^ HNG_DEFER_INSTRUMENT_HEADERGUARD
@@ -0,0 +1,274 @@
+#ifndef HNG_DEFER_STACK_HEADERGUARD
+#define HNG_DEFER_STACK_HEADERGUARD
+//
+//	Licence:	MIT
+//	GitHub:		https://github.com/highestnamegames/defer
+//	Version:	v1.1.0
+//
+//	Summary:
+//		A dynamic stack of deferred callables which are invoked in LIFO order
+//		at the end of the scope.
+//		Callables are type-erased into an inline buffer; storage only spills
+//		to heap allocated chunks when the inline buffer is full.
+//
+//	Example:
+//		```
+//			hng::defer_stack cleanup;
+//			for (auto const& path : paths) {
+//				int const fd = ::open(path, O_RDONLY);
+//				cleanup.push([fd]()noexcept{ ::close(fd); });
+//			}
+//			// ... all files are closed in reverse order at the end of the scope ...
+//		```
+//
+
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <type_traits>
+#include <hng/defer/defer_core.h>
+
+namespace hng {
+	namespace detail {
+		namespace defer_stack {
+
+			// Header of a type-erased callable stored in the arena.
+			// The callable immediately follows the header (suitably aligned).
+			struct entry
+			{
+				// Invokes the callable if `run` is true, then destroys it.
+				void (*m_fn)(entry* self, bool run) noexcept;
+				entry* m_prev;
+			};
+
+			// Heap allocated overflow region. The region's bytes immediately follow the header.
+			struct chunk
+			{
+				chunk* m_prev;
+				chunk* m_next;
+				unsigned char* m_prev_cursor;
+				std::size_t m_size;
+			};
+
+			constexpr std::size_t max_align = alignof(std::max_align_t);
+			constexpr std::size_t chunk_header_size = (sizeof(chunk) + max_align - 1) & ~(max_align - 1);
+			constexpr std::size_t min_chunk_size = 1024;
+
+			inline unsigned char* chunk_data(chunk* c) noexcept {
+				return reinterpret_cast<unsigned char*>(c) + chunk_header_size;
+			}
+
+			inline unsigned char* align_up(unsigned char* p, std::size_t align) noexcept {
+				return reinterpret_cast<unsigned char*>((reinterpret_cast<std::size_t>(p) + (align - 1)) & ~(align - 1));
+			}
+
+			// The largest region which a chunk can hold, so that the header and the region size do not overflow.
+			constexpr std::size_t max_region_size = std::size_t(-1) - chunk_header_size;
+
+			// The size of a new chunk for at least `size` bytes: double the previous chunk's size until it fits,
+			// or `size` itself once doubling would overflow. Throws std::bad_alloc if no chunk can hold `size` bytes.
+			inline std::size_t next_chunk_size(std::size_t previous, std::size_t size) {
+				if (size > max_region_size) {
+					DETAIL_HNG_DEFER_THROW(std::bad_alloc());
+				}
+				std::size_t chunk_size = previous == 0 ? min_chunk_size : (previous <= max_region_size / 2 ? previous * 2 : size);
+				while (chunk_size < size) {
+					chunk_size = chunk_size <= max_region_size / 2 ? chunk_size * 2 : size;
+				}
+				return chunk_size;
+			}
+
+			// LIFO bump allocator.
+			// Starts in the inline buffer, and moves on to chunks when the current region is full.
+			// Chunks are kept after they are emptied, and reused before allocating new ones.
+			template<std::size_t InlineBytes>
+			class arena
+			{
+			private:
+				alignas(std::max_align_t) unsigned char m_inline[InlineBytes];
+				unsigned char* m_cursor;
+				unsigned char* m_end;
+				chunk* m_chunk; // current chunk, or nullptr while the inline buffer is in use
+				chunk* m_first;
+			public:
+				inline ~arena() noexcept {
+					chunk* c = m_first;
+					while (c) {
+						chunk* const next = c->m_next;
+						::operator delete(static_cast<void*>(c));
+						c = next;
+					}
+				}
+				inline arena(arena const&) = delete;
+				inline arena(arena&&) = delete;
+				inline arena& operator=(arena const&) = delete;
+				inline arena& operator=(arena&&) = delete;
+				inline arena() noexcept : m_cursor(m_inline), m_end(m_inline + InlineBytes), m_chunk(nullptr), m_first(nullptr) {}
+
+				// May throw std::bad_alloc when a new chunk is required.
+				inline void* allocate(std::size_t size, std::size_t align) {
+					unsigned char* p = align_up(m_cursor, align);
+					if (p > m_end || std::size_t(m_end - p) < size) {
+						p = next_region(size);
+					}
+					m_cursor = p + size;
+					return p;
+				}
+
+				// Releases everything, in O(1). Chunks are kept for reuse.
+				inline void reset() noexcept {
+					m_cursor = m_inline;
+					m_end = m_inline + InlineBytes;
+					m_chunk = nullptr;
+				}
+
+				// Releases `p` and everything allocated after it.
+				inline void rewind(void* p) noexcept {
+					m_cursor = static_cast<unsigned char*>(p);
+					while (m_chunk && m_cursor == chunk_data(m_chunk)) {
+						unsigned char* const prev_cursor = m_chunk->m_prev_cursor;
+						m_chunk = m_chunk->m_prev;
+						if (m_chunk) {
+							m_end = chunk_data(m_chunk) + m_chunk->m_size;
+						}
+						else {
+							m_end = m_inline + InlineBytes;
+						}
+						m_cursor = prev_cursor;
+					}
+				}
+
+			private:
+				inline unsigned char* next_region(std::size_t size) {
+					chunk* next = m_chunk ? m_chunk->m_next : m_first;
+					if (!(next && next->m_size >= size)) {
+						std::size_t const chunk_size = next_chunk_size(m_chunk ? m_chunk->m_size : 0, size);
+						chunk* const created = static_cast<chunk*>(::operator new(chunk_header_size + chunk_size));
+						created->m_size = chunk_size;
+						created->m_next = next; // an unsuitable cached chunk is kept after the new one
+						created->m_prev = m_chunk;
+						if (m_chunk) {
+							m_chunk->m_next = created;
+						}
+						else {
+							m_first = created;
+						}
+						if (next) {
+							next->m_prev = created;
+						}
+						next = created;
+					}
+					next->m_prev_cursor = m_cursor;
+					m_chunk = next;
+					m_end = chunk_data(next) + next->m_size;
+					return chunk_data(next);
+				}
+			};
+
+			template<class F>
+			struct callable_entry
+			{
+				static constexpr std::size_t offset = (sizeof(entry) + alignof(F) - 1) & ~(alignof(F) - 1);
+				static constexpr std::size_t size = offset + sizeof(F);
+				static constexpr std::size_t align = alignof(F) > alignof(entry) ? alignof(F) : alignof(entry);
+
+				static F* callable(entry* e) noexcept {
+					return reinterpret_cast<F*>(reinterpret_cast<unsigned char*>(e) + offset);
+				}
+
+				static void fn(entry* e, bool run) noexcept {
+					F* const f = callable(e);
+					if (run) {
+						std::move(*f)();
+					}
+					f->~F();
+				}
+			};
+
+			// Stores the callable in the arena, as an entry linked to `prev`, and returns the entry.
+			// If the callable cannot be stored (allocation or construction throws),
+			// the arena is rewound and the exception is propagated.
+			template<class Arena, class Callable>
+			inline entry* push_entry(Arena& arena, entry* prev, Callable&& callable) {
+				using F = std::decay_t<Callable>;
+				using traits = callable_entry<F>;
+
+				void* const p = arena.allocate(traits::size, traits::align);
+				bool constructed = false;
+				auto const rewind_on_failure = [&]()noexcept {
+					if (!constructed) {
+						arena.rewind(p);
+					}
+				};
+				::hng::defer<decltype(rewind_on_failure)> const rewind_on_failure_defer(rewind_on_failure);
+
+				entry* const e = ::new (p) entry{ &traits::fn, prev };
+				::new (static_cast<void*>(traits::callable(e))) F(std::forward<Callable>(callable));
+				constructed = true;
+				return e;
+			}
+
+		}
+	}
+
+	// A stack of deferred callables, invoked in LIFO order when the stack is destroyed.
+	// The first `InlineBytes` bytes of entries are stored inline without any heap allocation.
+	template<std::size_t InlineBytes>
+	class basic_defer_stack
+	{
+	private:
+		detail::defer_stack::arena<InlineBytes> m_arena;
+		detail::defer_stack::entry* m_top;
+		std::size_t m_size;
+
+		inline void unwind(bool run) noexcept {
+			while (m_top) {
+				detail::defer_stack::entry* const e = m_top;
+				m_top = e->m_prev;
+				--m_size;
+				e->m_fn(e, run);
+				m_arena.rewind(e);
+			}
+		}
+	public:
+		inline ~basic_defer_stack() noexcept { unwind(true); }
+		inline basic_defer_stack(basic_defer_stack const&) = delete;
+		inline basic_defer_stack(basic_defer_stack&&) = delete;
+		inline basic_defer_stack& operator=(basic_defer_stack const&) = delete;
+		inline basic_defer_stack& operator=(basic_defer_stack&&) = delete;
+		inline basic_defer_stack() noexcept : m_arena(), m_top(nullptr), m_size(0) {}
+
+		// Defers the callable to the end of the scope.
+		// If the callable cannot be stored (allocation or construction throws),
+		// nothing is pushed and the exception is propagated.
+		template<class Callable>
+		inline void push(Callable&& callable) {
+			using F = std::decay_t<Callable>;
+			static_assert(noexcept(std::declval<F&&>()()), "the deferred callable must be noexcept");
+			static_assert(alignof(F) <= alignof(std::max_align_t), "over-aligned callables are not supported");
+
+			m_top = detail::defer_stack::push_entry(m_arena, m_top, std::forward<Callable>(callable));
+			++m_size;
+		}
+
+		// Invokes and removes the most recently pushed callable.
+		// The stack must not be empty.
+		inline void pop() noexcept {
+			detail::defer_stack::entry* const e = m_top;
+			m_top = e->m_prev;
+			--m_size;
+			e->m_fn(e, true);
+			m_arena.rewind(e);
+		}
+
+		// Removes all callables without invoking them.
+		inline void release() noexcept { unwind(false); }
+
+		inline bool empty() const noexcept { return m_top == nullptr; }
+		inline std::size_t size() const noexcept { return m_size; }
+	};
+
+	using defer_stack = basic_defer_stack<512>;
+}
+
+#endif // ^^^ HNG_DEFER_STACK_HEADERGUARD
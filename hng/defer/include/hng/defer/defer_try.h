@@ -0,0 +1,564 @@
+#ifndef HNG_DEFER_TRY_HEADERGUARD
+#define HNG_DEFER_TRY_HEADERGUARD
+//
+//	Licence:	MIT
+//	GitHub:		https://github.com/highestnamegames/defer
+//	Version:	v1.1.0
+//
+//	Summary:
+//		The HNG_DT DEFER_FINALLY/TRY/END macros, HNG_DT_CHAIN (several finally blocks around one try block),
+//		and the exception types which preserve the exceptions of both blocks (hng::defer_exception, hng::defer_aggregate_exception).
+//		In builds without exceptions (-fno-exceptions), the DT constructs are plain scope-exit sequences:
+//		the finally block is invoked after the try block's result has been constructed, and no try/catch is emitted.
+//		Compatible with C++11, C++14, C++17.
+//		In C++20, the DT constructs (without HNG_DEFER_INSTRUMENT) can be used in constexpr functions:
+//		constant evaluation takes the non-throwing path, and invokes the finally blocks after the try block.
+//
+
+#include <exception>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <type_traits>
+#include <vector>
+#include <hng/defer/defer_core.h>
+
+namespace hng {
+
+	class defer_exception : public std::runtime_error {
+	private:
+		std::exception_ptr m_exception_ptr{};
+	public:
+		inline virtual ~defer_exception() noexcept = default;
+		inline defer_exception(defer_exception&&) noexcept = default;
+		inline defer_exception(defer_exception const&) = default;
+		inline defer_exception& operator=(defer_exception&&) noexcept = default;
+		inline defer_exception& operator=(defer_exception const&) = default;
+		inline defer_exception() : runtime_error("defer exception") {}
+		inline explicit defer_exception(char const* message, std::exception_ptr&& exception_ptr) : runtime_error(message), m_exception_ptr(std::move(exception_ptr)) {}
+		inline explicit defer_exception(char const* message, std::exception_ptr const& exception_ptr) : runtime_error(message), m_exception_ptr(exception_ptr) {}
+		inline explicit defer_exception(std::string const& message, std::exception_ptr&& exception_ptr) : runtime_error(message), m_exception_ptr(std::move(exception_ptr)) {}
+		inline explicit defer_exception(std::string const& message, std::exception_ptr const& exception_ptr) : runtime_error(message), m_exception_ptr(exception_ptr) {}
+		inline explicit defer_exception(std::exception_ptr&& exception_ptr) : defer_exception("defer exception", std::move(exception_ptr)) {}
+		inline explicit defer_exception(std::exception_ptr const& exception_ptr) : defer_exception("defer exception", exception_ptr) {}
+		inline std::exception_ptr& exception_ptr() noexcept { return m_exception_ptr; }
+		inline std::exception_ptr const& exception_ptr() const noexcept { return m_exception_ptr; }
+	};
+
+	// Holds any number of exceptions, in the order in which they occurred.
+	// Exceptions are added from catch blocks with std::current_exception(), without rethrowing them.
+	// exception_ptr() is the most recently added exception.
+	class defer_aggregate_exception : public defer_exception {
+	private:
+		std::vector<std::exception_ptr> m_exceptions{};
+	public:
+		inline virtual ~defer_aggregate_exception() noexcept = default;
+		inline defer_aggregate_exception(defer_aggregate_exception&&) noexcept = default;
+		inline defer_aggregate_exception(defer_aggregate_exception const&) = default;
+		inline defer_aggregate_exception& operator=(defer_aggregate_exception&&) noexcept = default;
+		inline defer_aggregate_exception& operator=(defer_aggregate_exception const&) = default;
+		inline defer_aggregate_exception() : defer_exception("defer aggregate exception", std::exception_ptr()) {}
+		inline explicit defer_aggregate_exception(char const* message) : defer_exception(message, std::exception_ptr()) {}
+		inline explicit defer_aggregate_exception(std::string const& message) : defer_exception(message, std::exception_ptr()) {}
+		inline explicit defer_aggregate_exception(std::vector<std::exception_ptr> exceptions) : defer_aggregate_exception() {
+			m_exceptions = std::move(exceptions);
+			if (!m_exceptions.empty()) {
+				exception_ptr() = m_exceptions.back();
+			}
+		}
+
+		inline void add(std::exception_ptr const& e) {
+			m_exceptions.push_back(e);
+			exception_ptr() = e;
+		}
+
+		inline std::vector<std::exception_ptr> const& exceptions() const noexcept { return m_exceptions; }
+		inline std::size_t size() const noexcept { return m_exceptions.size(); }
+		inline bool empty() const noexcept { return m_exceptions.empty(); }
+
+		// Throws the aggregate (moved) if it holds any exception.
+		inline void throw_if_any() {
+			if (!m_exceptions.empty()) {
+				DETAIL_HNG_DEFER_THROW(std::move(*this));
+			}
+		}
+	};
+
+	namespace detail {
+		namespace defer {
+
+#if DETAIL_HNG_DEFER_HAS_EXCEPTIONS
+
+			// Called from a catch block of the finally block, while the try block exception is also being handled.
+			[[noreturn]] inline void dt_throw_aggregate(std::exception_ptr&& try_block_exception) {
+				std::vector<std::exception_ptr> exceptions;
+				exceptions.reserve(2);
+				exceptions.push_back(std::move(try_block_exception));
+				exceptions.push_back(std::current_exception());
+				throw ::hng::defer_aggregate_exception(std::move(exceptions));
+			}
+
+			// The catch paths of HNG_DT_DEFER_FINALLY_PRESERVE and HNG_DT_DEFER_FINALLY_AGGREGATE,
+			// called from the handler of the try block exception.
+			// They are functions rather than statements of HNG_DT_END, so that the immediately invoked lambda
+			// declares no std::exception_ptr variable, and stays usable in constant evaluation (C++20).
+			template<class F>
+			inline void dt_invoke_finally_preserve(F& finally) {
+				std::exception_ptr try_block_exception = std::current_exception();
+				try {
+					std::move(finally)();
+				}
+				catch (...) {
+					std::exception_ptr defer_block_exception = std::current_exception();
+					try {
+						std::rethrow_exception(std::move(try_block_exception));
+					}
+					catch (...) {
+						std::throw_with_nested(::hng::defer_exception(std::move(defer_block_exception)));
+					}
+				}
+			}
+
+			template<class F>
+			inline void dt_invoke_finally_aggregate(F& finally) {
+				std::exception_ptr try_block_exception = std::current_exception();
+				try {
+					std::move(finally)();
+				}
+				catch (...) {
+					dt_throw_aggregate(std::move(try_block_exception));
+				}
+			}
+
+			// Tells the finally blocks of a HNG_DT_CHAIN that they are invoked by the handler of the try block exception;
+			// other finally blocks ignore it.
+			template<class F>
+			inline void dt_chain_mark_caught(F&) noexcept {}
+
+#endif // ^^^ DETAIL_HNG_DEFER_HAS_EXCEPTIONS
+
+#if !DETAIL_HNG_DEFER_HAS_CPP17
+
+			// Used by the C++11/14 expansion of HNG_DT_END only.
+			template<class F, typename EIF = std::enable_if_t<std::is_same_v<std::decay_t<decltype(std::declval<F&&>()())>, void>, void>>
+			int dt_invoke(F&& f) {
+				std::forward<F>(f)();
+				return 0;
+			}
+
+			template<class F, typename EIF = std::enable_if_t<!std::is_same_v<std::decay_t<decltype(std::declval<F&&>()())>, void>, void>>
+			decltype(auto) dt_invoke(F&& f) {
+				return std::forward<F>(f)();
+			}
+
+			template<class T, typename EIF = std::enable_if_t<std::is_lvalue_reference_v<T>, void>>
+			T dt_return_forward(T value) noexcept {
+				return value;
+			}
+
+			template<class T, class U, typename EIF = std::enable_if_t<!std::is_lvalue_reference_v<T>, void>>
+			std::remove_reference_t<T> dt_return_forward(U&& value) noexcept(std::is_nothrow_constructible_v<std::decay_t<T>, U&&>) {
+				return T(std::move(value));
+			}
+
+#endif // ^^^ !DETAIL_HNG_DEFER_HAS_CPP17
+
+#if DETAIL_HNG_DEFER_HAS_CPP17
+
+			// Invokes the finally block of a noexcept try block, after the try block's result has been constructed.
+			template<class F>
+			struct dt_finally_guard
+			{
+				F& m_finally;
+				inline DETAIL_HNG_DEFER_CONSTEXPR20 ~dt_finally_guard() noexcept(noexcept(std::declval<F&&>()())) { std::move(m_finally)(); }
+				inline dt_finally_guard(dt_finally_guard const&) = delete;
+				inline dt_finally_guard& operator=(dt_finally_guard const&) = delete;
+				inline DETAIL_HNG_DEFER_CONSTEXPR20 explicit dt_finally_guard(F& finally) noexcept : m_finally(finally) {}
+			};
+
+			// Invokes the finally block after the try block's result has been constructed,
+			// unless the scope is being exited by an exception, which is left to the catch block.
+			template<class F>
+			struct dt_finally_guard_on_return
+			{
+				F& m_finally;
+				bool& m_invoked;
+				int m_uncaught_exceptions;
+				inline DETAIL_HNG_DEFER_CONSTEXPR20 ~dt_finally_guard_on_return() noexcept(noexcept(std::declval<F&&>()())) {
+					if (::hng::detail::defer::uncaught_exceptions() == m_uncaught_exceptions) {
+						m_invoked = true;
+						std::move(m_finally)();
+					}
+				}
+				inline dt_finally_guard_on_return(dt_finally_guard_on_return const&) = delete;
+				inline dt_finally_guard_on_return& operator=(dt_finally_guard_on_return const&) = delete;
+				inline DETAIL_HNG_DEFER_CONSTEXPR20 explicit dt_finally_guard_on_return(F& finally, bool& invoked) noexcept : m_finally(finally), m_invoked(invoked), m_uncaught_exceptions(::hng::detail::defer::uncaught_exceptions()) {}
+			};
+
+#if DETAIL_HNG_DEFER_HAS_EXCEPTIONS
+
+			// Wraps the exception of a finally block like HNG_DT_DEFER_FINALLY_PRESERVE:
+			// a hng::defer_exception holding the finally block exception, with the earlier exception nested.
+			inline std::exception_ptr dt_preserve(std::exception_ptr earlier, std::exception_ptr finally_exception) noexcept {
+				if (!earlier)
+					return finally_exception;
+				try {
+					try {
+						std::rethrow_exception(std::move(earlier));
+					}
+					catch (...) {
+						std::throw_with_nested(::hng::defer_exception(std::move(finally_exception)));
+					}
+				}
+				catch (...) {
+					return std::current_exception();
+				}
+			}
+
+#endif // ^^^ DETAIL_HNG_DEFER_HAS_EXCEPTIONS
+
+			template<class Prev, class F>
+			struct dt_chain;
+
+			// The start of a HNG_DT_CHAIN.
+			struct dt_chain_root
+			{
+				static constexpr bool is_nothrow = true;
+				bool m_caught = false;
+
+				inline DETAIL_HNG_DEFER_CONSTEXPR20 bool& caught() noexcept { return m_caught; }
+				inline DETAIL_HNG_DEFER_CONSTEXPR20 void run() noexcept {}
+				inline void run(std::exception_ptr&, bool&) noexcept {}
+
+				template<class F>
+				inline DETAIL_HNG_DEFER_CONSTEXPR20 dt_chain<dt_chain_root, std::decay_t<F>> operator<<(F&& finally) && {
+					return dt_chain<dt_chain_root, std::decay_t<F>>{ std::move(*this), std::forward<F>(finally) };
+				}
+			};
+
+			// The finally blocks of a HNG_DT_CHAIN: `m_finally` was declared last, `m_prev` holds the earlier ones.
+			template<class Prev, class F>
+			struct dt_chain
+			{
+				static constexpr bool is_nothrow = Prev::is_nothrow && noexcept(std::declval<F&&>()());
+				Prev m_prev;
+				F m_finally;
+
+				inline DETAIL_HNG_DEFER_CONSTEXPR20 bool& caught() noexcept { return m_prev.caught(); }
+
+				// Invokes this finally block, then the earlier ones, when none of them can throw
+				// (or during constant evaluation, where nothing is thrown).
+				inline DETAIL_HNG_DEFER_CONSTEXPR20 void run() noexcept {
+					std::move(m_finally)();
+					m_prev.run();
+				}
+
+				// Invokes this finally block, then the earlier ones.
+				// The exception of a finally block is preserved into `pending`, and the next finally blocks still run.
+				inline void run(std::exception_ptr& pending, bool& threw) noexcept {
+					if constexpr (noexcept(std::declval<F&&>()())) {
+						std::move(m_finally)();
+					}
+					else {
+#if DETAIL_HNG_DEFER_HAS_EXCEPTIONS
+						try {
+							std::move(m_finally)();
+						}
+						catch (...) {
+							pending = dt_preserve(std::move(pending), std::current_exception());
+							threw = true;
+						}
+#else
+						std::move(m_finally)();
+#endif // ^^^ DETAIL_HNG_DEFER_HAS_EXCEPTIONS
+					}
+					m_prev.run(pending, threw);
+				}
+
+				// Invokes the finally blocks in reverse order of declaration.
+				// If any throws, the preserved exception (which nests the try block exception, if any) is thrown once all have run.
+				inline DETAIL_HNG_DEFER_CONSTEXPR20 void operator()() && noexcept(is_nothrow) {
+					if constexpr (is_nothrow) {
+						run();
+					}
+					else {
+#if DETAIL_HNG_DEFER_HAS_CPP20_CONSTEXPR
+						if (std::is_constant_evaluated()) {
+							run();
+							return;
+						}
+#endif // ^^^ DETAIL_HNG_DEFER_HAS_CPP20_CONSTEXPR
+						run_preserving();
+					}
+				}
+
+				inline void run_preserving() {
+					std::exception_ptr pending;
+					bool threw = false;
+#if DETAIL_HNG_DEFER_HAS_EXCEPTIONS
+					if (caught()) {
+						pending = std::current_exception(); // the try block exception, inside its handler
+					}
+#endif // ^^^ DETAIL_HNG_DEFER_HAS_EXCEPTIONS
+					run(pending, threw);
+#if DETAIL_HNG_DEFER_HAS_EXCEPTIONS
+					if (threw) {
+						std::rethrow_exception(std::move(pending));
+					}
+#endif // ^^^ DETAIL_HNG_DEFER_HAS_EXCEPTIONS
+				}
+
+				template<class G>
+				inline DETAIL_HNG_DEFER_CONSTEXPR20 dt_chain<dt_chain, std::decay_t<G>> operator<<(G&& finally) && {
+					return dt_chain<dt_chain, std::decay_t<G>>{ std::move(*this), std::forward<G>(finally) };
+				}
+			};
+
+#if DETAIL_HNG_DEFER_HAS_EXCEPTIONS
+
+			template<class Prev, class F>
+			inline void dt_chain_mark_caught(dt_chain<Prev, F>& chain) noexcept {
+				chain.caught() = true;
+			}
+
+#if defined(HNG_DEFER_INSTRUMENT)
+			template<class Callable>
+			inline void dt_chain_mark_caught(::hng::detail::defer_instrument::timed<Callable>& t) noexcept {
+				dt_chain_mark_caught(t.m_callable);
+			}
+#endif // ^^^ HNG_DEFER_INSTRUMENT
+
+#endif // ^^^ DETAIL_HNG_DEFER_HAS_EXCEPTIONS
+
+#endif // ^^^ DETAIL_HNG_DEFER_HAS_CPP17
+
+		}
+	}
+}
+
+
+
+// The immediately invoked lambda is generic so that the `if constexpr` branches which do not apply
+// to the try block's result type are discarded, even when the construct is used outside of a template.
+#define DETAIL_HNG_DT_DEFER_FINALLY(mode)\
+	(([&](auto&&...)->decltype(auto){\
+	DETAIL_HNG_DEFER_SITE(DT)\
+	DETAIL_HNG_DEFER_CONSTEXPR_VAR int const DETAIL_HNG_DT_mode=(mode);\
+	auto DETAIL_HNG_DT_finally=(DETAIL_HNG_DEFER_SITE_VALUE_BEGIN(DT)
+
+
+// If the try block throws and the defer block throws, the defer block exception is propagated and the try block exception is lost.
+#define HNG_DT_DEFER_FINALLY\
+	DETAIL_HNG_DT_DEFER_FINALLY(0)
+
+
+// If the try block throws and the defer block throws, the defer block exception is propagated via std::rethrow_exception()
+//   as a hng::defer_exception (which contains the exception_ptr that the defer block threw)
+//   mixed in with a std::nested_exception (the nested exception is the try block exception).
+// If the try block does not throw and the defer block throws, the defer block exception is propagated as-is.
+#define HNG_DT_DEFER_FINALLY_PRESERVE\
+	DETAIL_HNG_DT_DEFER_FINALLY(1)
+
+
+// If the try block throws and the defer block throws, a hng::defer_aggregate_exception is thrown
+//   which holds both exceptions: exceptions()[0] is the try block exception, exceptions()[1] the defer block exception.
+//   The exceptions are captured with std::current_exception(), so neither is rethrown.
+// If the try block does not throw and the defer block throws, the defer block exception is propagated as-is.
+#define HNG_DT_DEFER_FINALLY_AGGREGATE\
+	DETAIL_HNG_DT_DEFER_FINALLY(2)
+
+
+#if DETAIL_HNG_DEFER_HAS_CPP17
+
+// Several finally blocks around one try block, invoked in reverse order of declaration (like nested HNG_DT constructs):
+//   HNG_DT_CHAIN[&]{ close(a); } HNG_DT_AND[&]{ close(b); } HNG_DT_TRY[&]{ ... } HNG_DT_END;
+// The try block has one try/catch and one result path, whatever the number of finally blocks.
+// If finally blocks throw, the exceptions are preserved like nested HNG_DT_DEFER_FINALLY_PRESERVE constructs:
+//   each exception is wrapped in a hng::defer_exception with the earlier exception (or the try block exception) nested,
+//   and the remaining finally blocks still run.
+#define HNG_DT_CHAIN\
+	DETAIL_HNG_DT_DEFER_FINALLY(3)::hng::detail::defer::dt_chain_root()<<
+
+
+#define HNG_DT_AND\
+	<<
+
+#endif // ^^^ DETAIL_HNG_DEFER_HAS_CPP17
+
+
+// The try block's closure is constructed inside a try/catch, so that the finally block is invoked
+// when copying a capture throws, as when the try block itself throws.
+#if DETAIL_HNG_DEFER_HAS_EXCEPTIONS
+#define DETAIL_HNG_DT_TRY_FN_BEGIN\
+	auto DETAIL_HNG_DT_try_fn=[&]()->auto{try{return(
+#define DETAIL_HNG_DT_TRY_FN_END\
+	);}catch(...){DETAIL_HNG_DT_END_INVOKE_FINALLY(1);throw;}}();
+#else // ^^^^ DETAIL_HNG_DEFER_HAS_EXCEPTIONS
+#define DETAIL_HNG_DT_TRY_FN_BEGIN\
+	auto DETAIL_HNG_DT_try_fn=(
+#define DETAIL_HNG_DT_TRY_FN_END\
+	);
+#endif // ^^^^ !DETAIL_HNG_DEFER_HAS_EXCEPTIONS
+
+
+#define HNG_DT_TRY\
+	DETAIL_HNG_DEFER_SITE_VALUE_END);DETAIL_HNG_DT_TRY_FN_BEGIN
+
+
+#if DETAIL_HNG_DEFER_HAS_EXCEPTIONS
+
+#define DETAIL_HNG_DT_END_INVOKE_FINALLY(trycaught)\
+	do{\
+		DETAIL_HNG_DEFER_SITE_CAUGHT(DETAIL_HNG_DT_finally,(trycaught))\
+		DETAIL_HNG_DEFER_MSVC_PRAGMA("warning(push)")\
+		DETAIL_HNG_DEFER_MSVC_PRAGMA("warning(disable : 4127)")\
+		if DETAIL_HNG_DEFER_CONSTEXPR_IF ((trycaught)&&1==DETAIL_HNG_DT_mode){\
+		DETAIL_HNG_DEFER_MSVC_PRAGMA("warning(pop)")\
+			::hng::detail::defer::dt_invoke_finally_preserve(DETAIL_HNG_DT_finally);\
+		}\
+		DETAIL_HNG_DEFER_MSVC_PRAGMA("warning(push)")\
+		DETAIL_HNG_DEFER_MSVC_PRAGMA("warning(disable : 4127)")\
+		else if DETAIL_HNG_DEFER_CONSTEXPR_IF ((trycaught)&&2==DETAIL_HNG_DT_mode){\
+		DETAIL_HNG_DEFER_MSVC_PRAGMA("warning(pop)")\
+			::hng::detail::defer::dt_invoke_finally_aggregate(DETAIL_HNG_DT_finally);\
+		}\
+		DETAIL_HNG_DEFER_MSVC_PRAGMA("warning(push)")\
+		DETAIL_HNG_DEFER_MSVC_PRAGMA("warning(disable : 4127)")\
+		else if DETAIL_HNG_DEFER_CONSTEXPR_IF ((trycaught)&&3==DETAIL_HNG_DT_mode){\
+		DETAIL_HNG_DEFER_MSVC_PRAGMA("warning(pop)")\
+			::hng::detail::defer::dt_chain_mark_caught(DETAIL_HNG_DT_finally);\
+			::std::move(DETAIL_HNG_DT_finally)();\
+		}\
+		else{::std::move(DETAIL_HNG_DT_finally)();}\
+	}while(0)
+
+#else // ^^^^ DETAIL_HNG_DEFER_HAS_EXCEPTIONS
+
+// Without exceptions, neither block can throw, so the finally block is simply invoked, whatever the mode.
+#define DETAIL_HNG_DT_END_INVOKE_FINALLY(trycaught)\
+	do{\
+		DETAIL_HNG_DEFER_SITE_CAUGHT(DETAIL_HNG_DT_finally,(trycaught))\
+		static_cast<void>(DETAIL_HNG_DT_mode);\
+		::std::move(DETAIL_HNG_DT_finally)();\
+	}while(0)
+
+#endif // ^^^^ !DETAIL_HNG_DEFER_HAS_EXCEPTIONS
+
+
+#if DETAIL_HNG_DEFER_HAS_CPP17
+
+// When the finally block is noexcept, the result of the try block is returned directly from the immediately invoked lambda,
+// and the finally block is invoked by the destructor of `guard` after the result has been constructed,
+// so a prvalue result is constructed exactly once, directly in the caller's object (it may be non-movable).
+// An rvalue reference result is moved into a value before the finally block is invoked.
+// A trivially copyable (and copy constructible) result, or a movable result whose finally block can throw,
+// is instead stored in a local variable, and the finally block is invoked before returning it, like hand-written code.
+// This avoids the guard's std::uncaught_exceptions() calls, and destroys the result exactly once if the finally block throws:
+// GCC before 13 destroys a returned object twice when a local's destructor throws (GCC PR 33799).
+// A non-movable result with a throwing finally block can only use the guard, and is affected by that bug.
+// `set_invoked` is executed after a void or locally stored result is constructed, before the finally block is invoked.
+#define DETAIL_HNG_DT_END_TRY_RESULT_STATEMENTS(set_invoked,guard)\
+	if constexpr(::std::is_same_v<::std::decay_t<DETAIL_HNG_DT_try_fn_result_t>,void>){\
+		::std::move(DETAIL_HNG_DT_try_fn)();\
+		set_invoked\
+		DETAIL_HNG_DT_END_INVOKE_FINALLY(0);\
+	}else if constexpr((::std::is_trivially_copyable_v<DETAIL_HNG_DT_try_fn_result_t>&&::std::is_trivially_copy_constructible_v<DETAIL_HNG_DT_try_fn_result_t>)||\
+		(!noexcept(::std::move(DETAIL_HNG_DT_finally)())&&!::std::is_lvalue_reference_v<DETAIL_HNG_DT_try_fn_result_t>&&::std::is_move_constructible_v<::std::decay_t<DETAIL_HNG_DT_try_fn_result_t>>)){\
+		::std::decay_t<DETAIL_HNG_DT_try_fn_result_t> DETAIL_HNG_DT_result=::std::move(DETAIL_HNG_DT_try_fn)();\
+		set_invoked\
+		DETAIL_HNG_DT_END_INVOKE_FINALLY(0);\
+		return DETAIL_HNG_DT_result;\
+	}else{\
+		guard;\
+		if constexpr(::std::is_rvalue_reference_v<DETAIL_HNG_DT_try_fn_result_t>){\
+			return ::std::decay_t<DETAIL_HNG_DT_try_fn_result_t>(::std::move(DETAIL_HNG_DT_try_fn)());\
+		}else{\
+			return ::std::move(DETAIL_HNG_DT_try_fn)();\
+		}\
+	}
+
+// When the try block is noexcept, nothing can be caught, so the try block and the finally block
+// are invoked as a straight-line sequence without a try/catch (no landing pad, no EH table entries).
+#if DETAIL_HNG_DEFER_HAS_EXCEPTIONS
+#define DETAIL_HNG_DT_END_TRY_STATEMENTS\
+	do{\
+		using DETAIL_HNG_DT_try_fn_result_t=decltype(::std::move(DETAIL_HNG_DT_try_fn)());\
+		if constexpr(noexcept(::std::move(DETAIL_HNG_DT_try_fn)())){\
+			DETAIL_HNG_DT_END_TRY_RESULT_STATEMENTS(,\
+				::hng::detail::defer::dt_finally_guard<decltype(DETAIL_HNG_DT_finally)> const DETAIL_HNG_DT_guard(DETAIL_HNG_DT_finally))\
+		}else{\
+			bool DETAIL_HNG_DT_invoked=0;\
+			try{\
+				DETAIL_HNG_DT_END_TRY_RESULT_STATEMENTS(DETAIL_HNG_DT_invoked=1;,\
+					::hng::detail::defer::dt_finally_guard_on_return<decltype(DETAIL_HNG_DT_finally)> const DETAIL_HNG_DT_guard(DETAIL_HNG_DT_finally,DETAIL_HNG_DT_invoked))\
+			}catch(...){\
+				if(!DETAIL_HNG_DT_invoked){\
+					DETAIL_HNG_DT_END_INVOKE_FINALLY(1);\
+				}\
+				throw;\
+			}\
+		}\
+	}while(0)
+#else // ^^^^ DETAIL_HNG_DEFER_HAS_EXCEPTIONS
+// Without exceptions, every try block is invoked like a noexcept one.
+#define DETAIL_HNG_DT_END_TRY_STATEMENTS\
+	do{\
+		using DETAIL_HNG_DT_try_fn_result_t=decltype(::std::move(DETAIL_HNG_DT_try_fn)());\
+		DETAIL_HNG_DT_END_TRY_RESULT_STATEMENTS(,\
+			::hng::detail::defer::dt_finally_guard<decltype(DETAIL_HNG_DT_finally)> const DETAIL_HNG_DT_guard(DETAIL_HNG_DT_finally))\
+	}while(0)
+#endif // ^^^^ !DETAIL_HNG_DEFER_HAS_EXCEPTIONS
+
+#else // ^^^^ DETAIL_HNG_DEFER_HAS_CPP17
+
+#if DETAIL_HNG_DEFER_HAS_EXCEPTIONS
+#define DETAIL_HNG_DT_END_TRY_STATEMENTS\
+	do{\
+		bool DETAIL_HNG_DT_invoked=0;\
+		try{\
+			using DETAIL_HNG_DT_try_fn_result_t=decltype(::std::move(DETAIL_HNG_DT_try_fn)());\
+			::std::conditional_t<\
+				::std::is_same_v<::std::decay_t<DETAIL_HNG_DT_try_fn_result_t>,void>,\
+				int,\
+				::std::conditional_t<\
+				::std::is_lvalue_reference_v<DETAIL_HNG_DT_try_fn_result_t>,\
+				DETAIL_HNG_DT_try_fn_result_t,\
+				::std::decay_t<DETAIL_HNG_DT_try_fn_result_t>\
+			>>DETAIL_HNG_DT_result=::hng::detail::defer::dt_invoke(::std::move(DETAIL_HNG_DT_try_fn));\
+			DETAIL_HNG_DT_invoked=1;\
+			DETAIL_HNG_DT_END_INVOKE_FINALLY(0);\
+			return ::hng::detail::defer::dt_return_forward<DETAIL_HNG_DT_try_fn_result_t>(DETAIL_HNG_DT_result);\
+		}catch(...){\
+			if(!DETAIL_HNG_DT_invoked){\
+				DETAIL_HNG_DT_END_INVOKE_FINALLY(1);\
+			}\
+			throw;\
+		}\
+	}while(0)
+#else // ^^^^ DETAIL_HNG_DEFER_HAS_EXCEPTIONS
+#define DETAIL_HNG_DT_END_TRY_STATEMENTS\
+	do{\
+		using DETAIL_HNG_DT_try_fn_result_t=decltype(::std::move(DETAIL_HNG_DT_try_fn)());\
+		::std::conditional_t<\
+			::std::is_same_v<::std::decay_t<DETAIL_HNG_DT_try_fn_result_t>,void>,\
+			int,\
+			::std::conditional_t<\
+			::std::is_lvalue_reference_v<DETAIL_HNG_DT_try_fn_result_t>,\
+			DETAIL_HNG_DT_try_fn_result_t,\
+			::std::decay_t<DETAIL_HNG_DT_try_fn_result_t>\
+		>>DETAIL_HNG_DT_result=::hng::detail::defer::dt_invoke(::std::move(DETAIL_HNG_DT_try_fn));\
+		DETAIL_HNG_DT_END_INVOKE_FINALLY(0);\
+		return ::hng::detail::defer::dt_return_forward<DETAIL_HNG_DT_try_fn_result_t>(DETAIL_HNG_DT_result);\
+	}while(0)
+#endif // ^^^^ !DETAIL_HNG_DEFER_HAS_EXCEPTIONS
+
+#endif // ^^^^ !DETAIL_HNG_DEFER_HAS_CPP17
+
+
+#define HNG_DT_END\
+	DETAIL_HNG_DT_TRY_FN_END\
+	DETAIL_HNG_DT_END_TRY_STATEMENTS;\
+	})())
+
+
+#endif // ^^^ HNG_DEFER_TRY_HEADERGUARD
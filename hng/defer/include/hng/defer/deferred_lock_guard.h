@@ -0,0 +1,111 @@
+#ifndef HNG_DEFERRED_LOCK_GUARD_HEADERGUARD
+#define HNG_DEFERRED_LOCK_GUARD_HEADERGUARD
+//
+//	Licence:	MIT
+//	GitHub:		https://github.com/highestnamegames/defer
+//	Version:	v1.1.0
+//
+//	Summary:
+//		A lock guard with an inline defer list: work triggered inside the critical section
+//		(freeing memory, logging, notifying a condition variable) is registered with after_unlock(),
+//		and runs after the mutex has been released, in LIFO order, so the lock is held only for the shared state.
+//		Callables are type-erased into an inline buffer, without heap allocation, and only spill to
+//		heap allocated chunks (like hng::defer_stack) when the buffer is full.
+//		Compatible with C++17.
+//
+//	Example:
+//		```
+//			{
+//				hng::deferred_lock_guard<std::mutex> guard(mutex);
+//				std::unique_ptr<node> removed = remove_from(list);
+//				guard.after_unlock([removed = std::move(removed)]()noexcept{}); // freed after the unlock
+//				guard.after_unlock([&]()noexcept{ not_full.notify_one(); });
+//			} // unlocks, then notifies, then frees
+//		```
+//
+
+#include <cstddef>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include <hng/defer/defer_core.h>
+#include <hng/defer/defer_stack.h>
+
+namespace hng {
+
+	// Locks the mutex for the lifetime of the guard, like std::lock_guard, and invokes the callables
+	// registered with after_unlock() once the mutex has been released, in reverse order of registration.
+	// The callables are stored in an inline buffer of `InlineBytes` bytes; beyond it, in heap allocated chunks.
+	// The guard only allocates when the callables registered while it holds the mutex do not fit in the buffer,
+	// so size `InlineBytes` for the largest such set to keep the guard allocation-free.
+	// A callable is never invoked while the guard holds the mutex, so it may lock the mutex again.
+	template<class Mutex, std::size_t InlineBytes = 256>
+	class deferred_lock_guard
+	{
+	private:
+		Mutex& m_mutex;
+		bool m_owns;
+		detail::defer_stack::entry* m_top;
+		detail::defer_stack::arena<InlineBytes> m_arena;
+
+		inline void run_deferred() noexcept {
+			while (m_top) {
+				detail::defer_stack::entry* const e = m_top;
+				m_top = e->m_prev;
+				e->m_fn(e, true);
+			}
+			m_arena.reset();
+		}
+
+	public:
+		using mutex_type = Mutex;
+
+		inline deferred_lock_guard(deferred_lock_guard const&) = delete;
+		inline deferred_lock_guard(deferred_lock_guard&&) = delete;
+		inline deferred_lock_guard& operator=(deferred_lock_guard const&) = delete;
+		inline deferred_lock_guard& operator=(deferred_lock_guard&&) = delete;
+
+		inline explicit deferred_lock_guard(Mutex& mutex) : m_mutex(mutex), m_owns(false), m_top(nullptr), m_arena() {
+			m_mutex.lock();
+			m_owns = true;
+		}
+
+		// Takes ownership of a mutex which the calling thread has already locked.
+		inline deferred_lock_guard(Mutex& mutex, std::adopt_lock_t) noexcept : m_mutex(mutex), m_owns(true), m_top(nullptr), m_arena() {}
+
+		// Unlocks the mutex (unless unlock() was called), then invokes the deferred callables.
+		inline ~deferred_lock_guard() noexcept { unlock(); }
+
+		// Defers the callable until the mutex is released, and returns true.
+		// If the mutex is already released (by unlock()), the callable is invoked immediately, and false is returned.
+		// If the callable cannot be stored (allocation or construction throws), nothing is deferred and the exception is propagated.
+		template<class Callable>
+		inline bool after_unlock(Callable&& callable) {
+			using F = std::decay_t<Callable>;
+			static_assert(noexcept(std::declval<F&&>()()), "the deferred callable must be noexcept");
+			static_assert(alignof(F) <= alignof(std::max_align_t), "over-aligned callables are not supported");
+
+			if (!m_owns) {
+				F local(std::forward<Callable>(callable));
+				std::move(local)();
+				return false;
+			}
+			m_top = detail::defer_stack::push_entry(m_arena, m_top, std::forward<Callable>(callable));
+			return true;
+		}
+
+		// Releases the mutex now, and invokes the deferred callables. Does nothing if the mutex is already released.
+		inline void unlock() noexcept {
+			if (!m_owns)
+				return;
+			m_owns = false;
+			m_mutex.unlock();
+			run_deferred();
+		}
+
+		inline bool owns_lock() const noexcept { return m_owns; }
+		inline Mutex& mutex() const noexcept { return m_mutex; }
+	};
+}
+
+#endif // ^^^ HNG_DEFERRED_LOCK_GUARD_HEADERGUARD
@@ -0,0 +1,312 @@
+#ifndef HNG_DEFERRED_RECLAIMER_HEADERGUARD
+#define HNG_DEFERRED_RECLAIMER_HEADERGUARD
+//
+//	Licence:	MIT
+//	GitHub:		https://github.com/highestnamegames/defer
+//	Version:	v1.1.0
+//
+//	Summary:
+//		Epoch-based deferred reclamation for lock-free data structures.
+//		Readers pin the current epoch with a scoped read guard.
+//		Writers retire unlinked objects, which are freed in batches
+//		once every pinned reader has left the epoch in which they were retired.
+//		Compatible with C++17.
+//
+//	Example:
+//		```
+//			hng::deferred_reclaimer reclaimer;
+//
+//			// reader
+//			{
+//				hng::deferred_reclaimer::read_guard const guard(reclaimer);
+//				node* n = head.load(std::memory_order_acquire);
+//				// ... n is not freed until the guard is destroyed ...
+//			}
+//
+//			// writer
+//			node* old = head.exchange(replacement, std::memory_order_acq_rel);
+//			reclaimer.retire(old);
+//		```
+//
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace hng {
+	namespace detail {
+		namespace deferred_reclaimer {
+
+			// An object waiting to be freed, and the global epoch when it was retired.
+			struct retired
+			{
+				void* m_ptr;
+				void (*m_deleter)(void*) noexcept;
+				std::uint64_t m_epoch;
+			};
+
+			inline void free_all(std::vector<retired>& bag) noexcept {
+				for (retired const& r : bag) {
+					r.m_deleter(r.m_ptr);
+				}
+				bag.clear();
+			}
+
+			// Per thread state. Only the owning thread writes to it, except `m_epoch` which other threads read.
+			struct alignas(64) participant
+			{
+				// The epoch pinned by the thread, with the lowest bit set while pinned.
+				std::atomic<std::uint64_t> m_epoch{ 0 };
+				std::atomic<bool> m_in_use{ false };
+				participant* m_next = nullptr;
+				unsigned m_pin_depth = 0;
+				// Retirements since the last collection, so a bag held above the threshold
+				// by a pinned reader is not scanned on every retirement.
+				std::size_t m_retired_since_collect = 0;
+				std::vector<retired> m_bag;
+			};
+
+			constexpr std::uint64_t pinned_bit = 1;
+			constexpr std::uint64_t epoch_increment = 2;
+
+			struct domain
+			{
+				std::atomic<std::uint64_t> m_global_epoch{ epoch_increment };
+				std::atomic<participant*> m_participants{ nullptr };
+				// Objects retired by threads which have exited.
+				std::mutex m_orphans_mutex;
+				std::vector<retired> m_orphans;
+
+				inline ~domain() noexcept {
+					participant* p = m_participants.load(std::memory_order_acquire);
+					while (p) {
+						participant* const next = p->m_next;
+						free_all(p->m_bag);
+						delete p;
+						p = next;
+					}
+					free_all(m_orphans);
+				}
+
+				inline participant* acquire_participant() {
+					for (participant* p = m_participants.load(std::memory_order_acquire); p; p = p->m_next) {
+						bool expected = false;
+						if (!p->m_in_use.load(std::memory_order_relaxed) && p->m_in_use.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+							return p;
+						}
+					}
+					participant* const created = new participant();
+					created->m_in_use.store(true, std::memory_order_relaxed);
+					participant* head = m_participants.load(std::memory_order_relaxed);
+					do {
+						created->m_next = head;
+					} while (!m_participants.compare_exchange_weak(head, created, std::memory_order_release, std::memory_order_relaxed));
+					return created;
+				}
+
+				inline void release_participant(participant* p) noexcept {
+					if (!p->m_bag.empty()) {
+						std::lock_guard<std::mutex> const lock(m_orphans_mutex);
+						m_orphans.insert(m_orphans.end(), p->m_bag.begin(), p->m_bag.end());
+						p->m_bag.clear();
+					}
+					p->m_in_use.store(false, std::memory_order_release);
+				}
+
+				// Advances the global epoch if every pinned thread has observed it.
+				inline std::uint64_t try_advance() noexcept {
+					std::uint64_t const epoch = m_global_epoch.load(std::memory_order_seq_cst);
+					// Pairs with the fence after the pin in read_guard: either the scan sees the pin,
+					// or the reader's loads see the unlinking which preceded the retirement.
+					std::atomic_thread_fence(std::memory_order_seq_cst);
+					for (participant* p = m_participants.load(std::memory_order_acquire); p; p = p->m_next) {
+						std::uint64_t const local = p->m_epoch.load(std::memory_order_seq_cst);
+						if ((local & pinned_bit) && (local & ~pinned_bit) != epoch) {
+							return epoch;
+						}
+					}
+					std::uint64_t expected = epoch;
+					m_global_epoch.compare_exchange_strong(expected, epoch + epoch_increment, std::memory_order_seq_cst);
+					return m_global_epoch.load(std::memory_order_seq_cst);
+				}
+			};
+
+			// Objects retired in epoch `e` are unreachable once the global epoch reaches `e + 2` increments,
+			// because every thread pinned in `e` (or earlier) has since unpinned.
+			inline bool is_safe(std::uint64_t retired_epoch, std::uint64_t global_epoch) noexcept {
+				return retired_epoch + 2 * epoch_increment <= global_epoch;
+			}
+
+			// Frees the objects in the bag which are safe to free, and keeps the rest.
+			inline void collect(std::vector<retired>& bag, std::uint64_t global_epoch) noexcept {
+				std::size_t kept = 0;
+				for (std::size_t i = 0; i < bag.size(); ++i) {
+					if (is_safe(bag[i].m_epoch, global_epoch)) {
+						bag[i].m_deleter(bag[i].m_ptr);
+					}
+					else {
+						bag[kept++] = bag[i];
+					}
+				}
+				bag.resize(kept);
+			}
+
+			// The participants of the current thread, one per reclaimer it has used.
+			// The cache keeps each domain alive until the thread exits.
+			struct thread_cache
+			{
+				struct slot
+				{
+					std::shared_ptr<domain> m_domain;
+					participant* m_participant;
+				};
+				std::vector<slot> m_slots;
+				domain const* m_last_domain = nullptr;
+				participant* m_last_participant = nullptr;
+
+				inline ~thread_cache() noexcept {
+					for (slot& s : m_slots) {
+						s.m_domain->release_participant(s.m_participant);
+					}
+				}
+
+				inline participant* find(std::shared_ptr<domain> const& d) {
+					if (m_last_domain == d.get()) {
+						return m_last_participant;
+					}
+					participant* p = nullptr;
+					for (slot const& s : m_slots) {
+						if (s.m_domain == d) {
+							p = s.m_participant;
+							break;
+						}
+					}
+					if (!p) {
+						p = d->acquire_participant();
+						m_slots.push_back(slot{ d, p });
+					}
+					m_last_domain = d.get();
+					m_last_participant = p;
+					return p;
+				}
+
+				static inline thread_cache& instance() {
+					static thread_local thread_cache cache;
+					return cache;
+				}
+			};
+
+			template<class T, class Deleter>
+			void delete_retired(void* p) noexcept {
+				Deleter()(static_cast<T*>(p));
+			}
+
+		}
+	}
+
+	// Epoch-based reclamation domain.
+	// A thread which has used a reclaimer keeps the reclaimer's state alive until the thread exits,
+	// so objects retired by such threads may be freed after the reclaimer itself is destroyed.
+	class deferred_reclaimer
+	{
+	private:
+		std::shared_ptr<detail::deferred_reclaimer::domain> m_domain;
+		std::size_t m_collect_threshold;
+
+		inline detail::deferred_reclaimer::participant* self() {
+			return detail::deferred_reclaimer::thread_cache::instance().find(m_domain);
+		}
+
+		inline void unpin(detail::deferred_reclaimer::participant* p) noexcept {
+			if (--p->m_pin_depth == 0) {
+				p->m_epoch.store(0, std::memory_order_release);
+			}
+		}
+
+	public:
+		// Pins the current epoch for the lifetime of the guard.
+		// Objects retired while the guard exists are not freed until the guard is destroyed.
+		// Guards may be nested.
+		class read_guard
+		{
+		private:
+			deferred_reclaimer& m_reclaimer;
+			detail::deferred_reclaimer::participant* m_participant;
+		public:
+			inline ~read_guard() noexcept { m_reclaimer.unpin(m_participant); }
+			inline read_guard(read_guard const&) = delete;
+			inline read_guard(read_guard&&) = delete;
+			inline read_guard& operator=(read_guard const&) = delete;
+			inline read_guard& operator=(read_guard&&) = delete;
+			inline explicit read_guard(deferred_reclaimer& reclaimer) : m_reclaimer(reclaimer), m_participant(reclaimer.self()) {
+				if (m_participant->m_pin_depth++ == 0) {
+					std::uint64_t const epoch = m_reclaimer.m_domain->m_global_epoch.load(std::memory_order_relaxed);
+					m_participant->m_epoch.store(epoch | detail::deferred_reclaimer::pinned_bit, std::memory_order_relaxed);
+					// Orders the pin before the reader's loads of shared pointers (store-load ordering,
+					// which a seq_cst store alone does not give). Pairs with the fence in try_advance().
+					std::atomic_thread_fence(std::memory_order_seq_cst);
+				}
+			}
+		};
+
+		inline deferred_reclaimer(deferred_reclaimer const&) = delete;
+		inline deferred_reclaimer(deferred_reclaimer&&) = delete;
+		inline deferred_reclaimer& operator=(deferred_reclaimer const&) = delete;
+		inline deferred_reclaimer& operator=(deferred_reclaimer&&) = delete;
+
+		// Each thread tries to free its retired objects after `collect_threshold` retirements.
+		inline explicit deferred_reclaimer(std::size_t collect_threshold = 128)
+			: m_domain(std::make_shared<detail::deferred_reclaimer::domain>()), m_collect_threshold(collect_threshold) {}
+
+		inline read_guard pin() { return read_guard(*this); }
+
+		// Frees the object with `deleter(ptr)` once no reader can still hold it.
+		// Wait-free for the calling thread, except for the occasional growth of its retirement list,
+		// and the batched collection every `collect_threshold` calls.
+		inline void retire(void* ptr, void (*deleter)(void*) noexcept) {
+			detail::deferred_reclaimer::participant* const p = self();
+			p->m_bag.push_back(detail::deferred_reclaimer::retired{ ptr, deleter, m_domain->m_global_epoch.load(std::memory_order_seq_cst) });
+			if (++p->m_retired_since_collect >= m_collect_threshold) {
+				p->m_retired_since_collect = 0;
+				detail::deferred_reclaimer::collect(p->m_bag, m_domain->try_advance());
+			}
+		}
+
+		template<class T>
+		inline void retire(T* ptr, void (*deleter)(void*) noexcept) {
+			retire(static_cast<void*>(const_cast<std::remove_cv_t<T>*>(ptr)), deleter);
+		}
+
+		// Frees the object with a default constructed `Deleter` once no reader can still hold it.
+		template<class T, class Deleter = std::default_delete<T>>
+		inline void retire(T* ptr, Deleter = Deleter()) {
+			static_assert(std::is_empty<Deleter>::value && std::is_nothrow_default_constructible<Deleter>::value,
+				"the deleter must be stateless");
+			retire(static_cast<void*>(const_cast<std::remove_cv_t<T>*>(ptr)), &detail::deferred_reclaimer::delete_retired<T, Deleter>);
+		}
+
+		// Tries to advance the epoch, and frees the calling thread's retired objects which are safe to free.
+		// Objects retired by threads which have exited are freed too.
+		inline void collect() {
+			detail::deferred_reclaimer::participant* const p = self();
+			std::uint64_t const epoch = m_domain->try_advance();
+			p->m_retired_since_collect = 0;
+			detail::deferred_reclaimer::collect(p->m_bag, epoch);
+			std::lock_guard<std::mutex> const lock(m_domain->m_orphans_mutex);
+			detail::deferred_reclaimer::collect(m_domain->m_orphans, epoch);
+		}
+
+		// The number of objects retired by the calling thread which are not freed yet.
+		inline std::size_t pending() {
+			return self()->m_bag.size();
+		}
+	};
+}
+
+#endif // ^^^ HNG_DEFERRED_RECLAIMER_HEADERGUARD
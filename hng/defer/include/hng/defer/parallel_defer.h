@@ -0,0 +1,396 @@
+#ifndef HNG_PARALLEL_DEFER_HEADERGUARD
+#define HNG_PARALLEL_DEFER_HEADERGUARD
+//
+//	Licence:	MIT
+//	GitHub:		https://github.com/highestnamegames/defer
+//	Version:	v1.1.0
+//
+//	Summary:
+//		Runs independent scope-exit cleanups concurrently.
+//		A parallel_defer_group collects cleanups (closing files, flushing buffers, joining threads),
+//		and when the scope exits it runs them on a work-stealing parallel_defer_pool and blocks until all have finished;
+//		the blocked thread executes cleanups too.
+//		A cleanup may depend on earlier cleanups, and is then only started once they have finished.
+//		Exceptions thrown by the cleanups are collected into one hng::defer_aggregate_exception.
+//		Compatible with C++17.
+//
+//	Example:
+//		```
+//			hng::parallel_defer_pool pool; // one worker per core
+//			{
+//				hng::parallel_defer_group teardown(pool);
+//				for (auto& file : files) {
+//					teardown.add([&file] { file.close(); });
+//				}
+//				auto const flushed = teardown.add([&] { journal.flush(); });
+//				teardown.add([&] { journal.close(); }, { flushed });
+//			} // runs the cleanups concurrently, then throws hng::defer_aggregate_exception if any threw
+//		```
+//
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <hng/defer/defer_try.h>
+
+namespace hng {
+
+	class parallel_defer_pool;
+	class parallel_defer_group;
+
+	namespace detail {
+		namespace parallel_defer {
+
+			// The completion state of one run of a group. Workers only touch it while the group is waiting.
+			struct group_state
+			{
+				std::atomic<std::size_t> m_remaining{ 0 };
+				std::mutex m_mutex;
+				std::condition_variable m_wake;
+				// Set under m_mutex by the worker which finishes the last cleanup, so the group is not
+				// destroyed before that worker has released m_mutex.
+				bool m_finished = false;
+				std::vector<std::exception_ptr> m_exceptions;
+			};
+
+			struct node
+			{
+				group_state* m_group = nullptr;
+				std::size_t m_dependency_count = 0;
+				// The number of dependencies which have not finished yet.
+				std::atomic<std::size_t> m_pending{ 0 };
+				std::vector<node*> m_dependents;
+
+				virtual ~node() = default;
+				virtual void run() = 0;
+			};
+
+			template<class Callable>
+			struct callable_node final : node
+			{
+				Callable m_callable;
+
+				template<class C>
+				inline explicit callable_node(C&& callable) : m_callable(std::forward<C>(callable)) {}
+
+				inline void run() override { std::move(m_callable)(); }
+			};
+
+			struct worker_queue
+			{
+				std::mutex m_mutex;
+				std::deque<node*> m_nodes;
+			};
+
+			struct worker_identity
+			{
+				parallel_defer_pool const* m_pool;
+				std::size_t m_index;
+			};
+
+			inline worker_identity& current_worker() noexcept {
+				static thread_local worker_identity identity{ nullptr, 0 };
+				return identity;
+			}
+
+		}
+	}
+
+	// A pool of worker threads, each with its own deque of cleanups.
+	// A worker pops its newest cleanup, and steals the oldest cleanup of another worker when its deque is empty.
+	// The pool must outlive the groups which use it.
+	class parallel_defer_pool
+	{
+	private:
+		friend class parallel_defer_group;
+
+		std::vector<std::unique_ptr<detail::parallel_defer::worker_queue>> m_queues;
+		std::vector<std::thread> m_threads;
+		std::atomic<std::size_t> m_queued{ 0 };
+		std::atomic<std::size_t> m_next_queue{ 0 };
+		std::mutex m_sleep_mutex;
+		std::condition_variable m_wake;
+		bool m_stop = false;
+
+		inline bool has_work() const noexcept { return m_queued.load(std::memory_order_acquire) != 0; }
+
+		// Pushes to the calling worker's deque, or round-robin from other threads.
+		inline void push(detail::parallel_defer::node* n) {
+			detail::parallel_defer::worker_identity const& self = detail::parallel_defer::current_worker();
+			std::size_t const index = self.m_pool == this
+				? self.m_index
+				: m_next_queue.fetch_add(1, std::memory_order_relaxed) % m_queues.size();
+			{
+				detail::parallel_defer::worker_queue& q = *m_queues[index];
+				std::lock_guard<std::mutex> const lock(q.m_mutex);
+				q.m_nodes.push_back(n);
+			}
+			m_queued.fetch_add(1, std::memory_order_release);
+			{
+				std::lock_guard<std::mutex> const lock(m_sleep_mutex);
+			}
+			m_wake.notify_one();
+		}
+
+		inline detail::parallel_defer::node* try_pop() noexcept {
+			if (!has_work())
+				return nullptr;
+			detail::parallel_defer::worker_identity const& self = detail::parallel_defer::current_worker();
+			std::size_t const count = m_queues.size();
+			std::size_t const first = self.m_pool == this ? self.m_index : m_next_queue.load(std::memory_order_relaxed) % count;
+			for (std::size_t i = 0; i < count; ++i) {
+				std::size_t const index = (first + i) % count;
+				detail::parallel_defer::worker_queue& q = *m_queues[index];
+				std::lock_guard<std::mutex> const lock(q.m_mutex);
+				if (!q.m_nodes.empty()) {
+					detail::parallel_defer::node* n;
+					if (i == 0 && self.m_pool == this) {
+						n = q.m_nodes.back();
+						q.m_nodes.pop_back();
+					}
+					else {
+						n = q.m_nodes.front();
+						q.m_nodes.pop_front();
+					}
+					m_queued.fetch_sub(1, std::memory_order_relaxed);
+					return n;
+				}
+			}
+			return nullptr;
+		}
+
+		inline void notify_group(detail::parallel_defer::group_state& group) {
+			std::lock_guard<std::mutex> const lock(group.m_mutex);
+			group.m_wake.notify_all();
+		}
+
+		// Runs the cleanup, records its exception, releases its dependents,
+		// and signals the group if it was the last cleanup.
+		inline void execute(detail::parallel_defer::node* n) noexcept {
+			detail::parallel_defer::group_state& group = *n->m_group;
+			DETAIL_HNG_DEFER_TRY {
+				n->run();
+			}
+			DETAIL_HNG_DEFER_CATCH_ALL {
+				std::lock_guard<std::mutex> const lock(group.m_mutex);
+				group.m_exceptions.push_back(std::current_exception());
+			}
+			bool released = false;
+			for (detail::parallel_defer::node* const dependent : n->m_dependents) {
+				if (dependent->m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+					DETAIL_HNG_DEFER_TRY {
+						push(dependent);
+					}
+					DETAIL_HNG_DEFER_CATCH_ALL {
+						// The deque could not grow: run the dependent on this thread.
+						execute(dependent);
+					}
+					released = true;
+				}
+			}
+			if (released) {
+				notify_group(group);
+			}
+			if (group.m_remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+				std::lock_guard<std::mutex> const lock(group.m_mutex);
+				group.m_finished = true;
+				group.m_wake.notify_all();
+			}
+		}
+
+		inline void worker_loop(std::size_t index) noexcept {
+			detail::parallel_defer::current_worker() = detail::parallel_defer::worker_identity{ this, index };
+			for (;;) {
+				if (detail::parallel_defer::node* const n = try_pop()) {
+					execute(n);
+					continue;
+				}
+				std::unique_lock<std::mutex> lock(m_sleep_mutex);
+				m_wake.wait(lock, [this] { return m_stop || has_work(); });
+				if (m_stop && !has_work())
+					return;
+			}
+		}
+
+	public:
+		static inline std::size_t default_thread_count() noexcept {
+			unsigned const n = std::thread::hardware_concurrency();
+			return n ? n : 1;
+		}
+
+		inline parallel_defer_pool(parallel_defer_pool const&) = delete;
+		inline parallel_defer_pool(parallel_defer_pool&&) = delete;
+		inline parallel_defer_pool& operator=(parallel_defer_pool const&) = delete;
+		inline parallel_defer_pool& operator=(parallel_defer_pool&&) = delete;
+
+		inline explicit parallel_defer_pool(std::size_t threads = default_thread_count()) {
+			if (threads == 0) {
+				threads = 1;
+			}
+			m_queues.reserve(threads);
+			for (std::size_t i = 0; i < threads; ++i) {
+				m_queues.push_back(std::make_unique<detail::parallel_defer::worker_queue>());
+			}
+			m_threads.reserve(threads);
+			DETAIL_HNG_DEFER_TRY {
+				for (std::size_t i = 0; i < threads; ++i) {
+					m_threads.emplace_back([this, i] { worker_loop(i); });
+				}
+			}
+			DETAIL_HNG_DEFER_CATCH_ALL {
+				stop();
+				DETAIL_HNG_DEFER_RETHROW;
+			}
+		}
+
+		inline ~parallel_defer_pool() noexcept { stop(); }
+
+		inline std::size_t size() const noexcept { return m_queues.size(); }
+
+	private:
+		inline void stop() noexcept {
+			{
+				std::lock_guard<std::mutex> const lock(m_sleep_mutex);
+				m_stop = true;
+			}
+			m_wake.notify_all();
+			for (std::thread& t : m_threads) {
+				t.join();
+			}
+			m_threads.clear();
+		}
+	};
+
+	// Collects cleanups, and runs them concurrently on a parallel_defer_pool when the scope exits.
+	// Cleanups without dependencies may run in any order, on any thread.
+	class parallel_defer_group
+	{
+	public:
+		// Identifies a cleanup of the group, so that later cleanups can depend on it.
+		using cleanup_id = std::size_t;
+
+	private:
+		parallel_defer_pool& m_pool;
+		std::vector<std::unique_ptr<detail::parallel_defer::node>> m_nodes;
+		detail::parallel_defer::group_state m_state;
+		int m_uncaught_exceptions;
+
+		template<class Callable>
+		inline cleanup_id add_node(Callable&& callable, cleanup_id const* first, cleanup_id const* last) {
+			for (cleanup_id const* it = first; it != last; ++it) {
+				if (*it >= m_nodes.size())
+					DETAIL_HNG_DEFER_THROW(std::out_of_range("parallel_defer_group: a cleanup can only depend on an earlier cleanup"));
+			}
+			// Reserved first, so that the final push_back cannot throw once the dependents have been linked.
+			// The capacity grows geometrically: reserve(size() + 1) would reallocate on every add.
+			if (m_nodes.size() == m_nodes.capacity()) {
+				m_nodes.reserve(m_nodes.capacity() == 0 ? 1 : 2 * m_nodes.capacity());
+			}
+			auto n = std::make_unique<detail::parallel_defer::callable_node<std::decay_t<Callable>>>(std::forward<Callable>(callable));
+			n->m_group = &m_state;
+			n->m_dependency_count = static_cast<std::size_t>(last - first);
+			n->m_pending.store(n->m_dependency_count, std::memory_order_relaxed);
+			std::size_t added = 0;
+			DETAIL_HNG_DEFER_TRY {
+				for (cleanup_id const* it = first; it != last; ++it, ++added) {
+					m_nodes[*it]->m_dependents.push_back(n.get());
+				}
+			}
+			DETAIL_HNG_DEFER_CATCH_ALL {
+				for (cleanup_id const* it = first; added != 0; ++it, --added) {
+					m_nodes[*it]->m_dependents.pop_back();
+				}
+				DETAIL_HNG_DEFER_RETHROW;
+			}
+			m_nodes.push_back(std::move(n));
+			return m_nodes.size() - 1;
+		}
+
+		// Runs every collected cleanup and empties the group. Returns the exceptions thrown by the cleanups.
+		inline std::vector<std::exception_ptr> run_all() noexcept {
+			if (m_nodes.empty())
+				return {};
+			m_state.m_remaining.store(m_nodes.size(), std::memory_order_relaxed);
+			m_state.m_finished = false;
+			// m_pending of a dependent may already reach zero while the roots are being pushed.
+			for (auto const& n : m_nodes) {
+				if (n->m_dependency_count == 0) {
+					DETAIL_HNG_DEFER_TRY {
+						m_pool.push(n.get());
+					}
+					DETAIL_HNG_DEFER_CATCH_ALL {
+						m_pool.execute(n.get());
+					}
+				}
+			}
+			// Help the workers until the last cleanup has finished.
+			for (;;) {
+				if (detail::parallel_defer::node* const n = m_pool.try_pop()) {
+					m_pool.execute(n);
+					continue;
+				}
+				std::unique_lock<std::mutex> lock(m_state.m_mutex);
+				m_state.m_wake.wait(lock, [this] { return m_state.m_finished || m_pool.has_work(); });
+				if (m_state.m_finished)
+					break;
+			}
+			m_nodes.clear();
+			return std::exchange(m_state.m_exceptions, {});
+		}
+
+	public:
+		inline parallel_defer_group(parallel_defer_group const&) = delete;
+		inline parallel_defer_group(parallel_defer_group&&) = delete;
+		inline parallel_defer_group& operator=(parallel_defer_group const&) = delete;
+		inline parallel_defer_group& operator=(parallel_defer_group&&) = delete;
+		inline explicit parallel_defer_group(parallel_defer_pool& pool) noexcept : m_pool(pool), m_uncaught_exceptions(std::uncaught_exceptions()) {}
+
+		// Runs the remaining cleanups and waits for them.
+		// If cleanups threw, a hng::defer_aggregate_exception holding their exceptions is thrown,
+		// unless the scope is being exited by an exception, in which case they are discarded.
+		inline ~parallel_defer_group() noexcept(false) {
+			std::vector<std::exception_ptr> exceptions = run_all();
+			if (!exceptions.empty() && std::uncaught_exceptions() <= m_uncaught_exceptions) {
+				DETAIL_HNG_DEFER_THROW(::hng::defer_aggregate_exception(std::move(exceptions)));
+			}
+		}
+
+		// Adds a cleanup, which may start as soon as the group runs.
+		// If the cleanup cannot be stored, it is not added and the exception is propagated.
+		template<class Callable>
+		inline cleanup_id add(Callable&& callable) {
+			return add_node(std::forward<Callable>(callable), nullptr, nullptr);
+		}
+
+		// Adds a cleanup which only starts after the cleanups `after` have finished (even if they threw).
+		// Throws std::out_of_range if `after` names a cleanup which has not been added yet.
+		template<class Callable>
+		inline cleanup_id add(Callable&& callable, std::initializer_list<cleanup_id> after) {
+			return add_node(std::forward<Callable>(callable), after.begin(), after.end());
+		}
+
+		// The number of cleanups which have not run yet.
+		inline std::size_t size() const noexcept { return m_nodes.size(); }
+
+		// Runs the cleanups now, and waits for them. The group is empty afterwards, and can be reused.
+		// Throws a hng::defer_aggregate_exception holding the exceptions of the cleanups which threw.
+		inline void run() {
+			std::vector<std::exception_ptr> exceptions = run_all();
+			if (!exceptions.empty()) {
+				DETAIL_HNG_DEFER_THROW(::hng::defer_aggregate_exception(std::move(exceptions)));
+			}
+		}
+	};
+}
+
+#endif // ^^^ HNG_PARALLEL_DEFER_HEADERGUARD
@@ -0,0 +1,298 @@
+#ifndef HNG_SCOPED_ARENA_HEADERGUARD
+#define HNG_SCOPED_ARENA_HEADERGUARD
+//
+//	Licence:	MIT
+//	GitHub:		https://github.com/highestnamegames/defer
+//	Version:	v1.1.0
+//
+//	Summary:
+//		A monotonic (bump pointer) arena whose deallocation is a scope-exit action.
+//		A hng::scoped_arena takes a mark of a hng::arena when it is constructed,
+//		and defers rolling the arena back to that mark, in O(1), to the end of the scope;
+//		nested scopes roll back to their own marks.
+//		Objects which are not trivially destructible are linked into an intrusive list when they are created,
+//		and only they are destroyed (in reverse order) by the rollback.
+//		hng::arena_allocator lets standard containers allocate from the arena.
+//		Compatible with C++17.
+//
+//	Example:
+//		```
+//			hng::arena arena;
+//			for (auto const& request : requests) {
+//				hng::scoped_arena scope(arena);
+//				std::vector<token, hng::arena_allocator<token>> tokens(scope.allocator<token>());
+//				std::string* const path = scope.make<std::string>(request.path()); // destroyed by the rollback
+//				// ...
+//			} // the arena is rolled back to its state before the iteration
+//		```
+//
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <hng/defer/defer_core.h>
+
+namespace hng {
+	namespace detail {
+		namespace scoped_arena {
+
+			// Heap allocated region. The region's bytes immediately follow the header.
+			struct chunk
+			{
+				chunk* m_next;
+				std::size_t m_size;
+			};
+
+			// Registered destructor of an object created in the arena.
+			// The node is allocated in the arena, just before the object.
+			struct destructor
+			{
+				destructor* m_prev;
+				void (*m_destroy)(void* object) noexcept;
+				void* m_object;
+			};
+
+			constexpr std::size_t max_align = alignof(std::max_align_t);
+			constexpr std::size_t chunk_header_size = (sizeof(chunk) + max_align - 1) & ~(max_align - 1);
+			constexpr std::size_t min_chunk_size = 4096;
+
+			inline unsigned char* chunk_data(chunk* c) noexcept {
+				return reinterpret_cast<unsigned char*>(c) + chunk_header_size;
+			}
+
+			inline unsigned char* align_up(unsigned char* p, std::size_t align) noexcept {
+				return reinterpret_cast<unsigned char*>((reinterpret_cast<std::size_t>(p) + (align - 1)) & ~(align - 1));
+			}
+
+			// The largest region which a chunk can hold, so that the header and the region size do not overflow.
+			constexpr std::size_t max_region_size = std::size_t(-1) - chunk_header_size;
+
+			// The size of a new chunk for at least `size` bytes: double the previous chunk's size until it fits,
+			// or `size` itself once doubling would overflow. Throws std::bad_alloc if no chunk can hold `size` bytes.
+			inline std::size_t next_chunk_size(std::size_t previous, std::size_t size) {
+				if (size > max_region_size) {
+					DETAIL_HNG_DEFER_THROW(std::bad_alloc());
+				}
+				std::size_t chunk_size = previous == 0 ? min_chunk_size : (previous <= max_region_size / 2 ? previous * 2 : size);
+				while (chunk_size < size) {
+					chunk_size = chunk_size <= max_region_size / 2 ? chunk_size * 2 : size;
+				}
+				return chunk_size;
+			}
+
+			template<class T>
+			inline void destroy(void* object) noexcept {
+				static_cast<T*>(object)->~T();
+			}
+
+		}
+	}
+
+	// A monotonic allocator: memory is taken from the current region by bumping a pointer,
+	// and is only given back by rolling the arena back to an earlier mark (or when the arena is destroyed).
+	// Starts in an optional caller provided buffer, and moves on to heap allocated chunks when the current region is full.
+	// Chunks are kept when the arena is rolled back, and reused before allocating new ones.
+	class arena
+	{
+	public:
+		// A position in the arena: rolling back to it releases everything allocated after it was taken.
+		struct marker
+		{
+			detail::scoped_arena::chunk* m_chunk;
+			unsigned char* m_cursor;
+			detail::scoped_arena::destructor* m_destructors;
+		};
+
+	private:
+		unsigned char* m_cursor;
+		unsigned char* m_end;
+		detail::scoped_arena::chunk* m_chunk; // current chunk, or nullptr while the initial buffer is in use
+		detail::scoped_arena::chunk* m_first;
+		unsigned char* m_buffer;
+		std::size_t m_buffer_size;
+		detail::scoped_arena::destructor* m_destructors;
+
+		inline unsigned char* next_region(std::size_t size) {
+			using detail::scoped_arena::chunk;
+			chunk* next = m_chunk ? m_chunk->m_next : m_first;
+			if (!(next && next->m_size >= size)) {
+				std::size_t const chunk_size = detail::scoped_arena::next_chunk_size(m_chunk ? m_chunk->m_size : 0, size);
+				chunk* const created = static_cast<chunk*>(::operator new(detail::scoped_arena::chunk_header_size + chunk_size));
+				created->m_size = chunk_size;
+				created->m_next = next; // an unsuitable cached chunk is kept after the new one
+				if (m_chunk) {
+					m_chunk->m_next = created;
+				}
+				else {
+					m_first = created;
+				}
+				next = created;
+			}
+			m_chunk = next;
+			m_end = detail::scoped_arena::chunk_data(next) + next->m_size;
+			return detail::scoped_arena::chunk_data(next);
+		}
+
+	public:
+		inline ~arena() noexcept {
+			rewind(marker{ nullptr, m_buffer, nullptr });
+			detail::scoped_arena::chunk* c = m_first;
+			while (c) {
+				detail::scoped_arena::chunk* const next = c->m_next;
+				::operator delete(static_cast<void*>(c));
+				c = next;
+			}
+		}
+		inline arena(arena const&) = delete;
+		inline arena(arena&&) = delete;
+		inline arena& operator=(arena const&) = delete;
+		inline arena& operator=(arena&&) = delete;
+		inline arena() noexcept : arena(nullptr, 0) {}
+
+		// Allocates from `buffer` (which must outlive the arena) before allocating chunks.
+		inline arena(void* buffer, std::size_t size) noexcept
+			: m_cursor(static_cast<unsigned char*>(buffer)), m_end(static_cast<unsigned char*>(buffer) + size),
+			m_chunk(nullptr), m_first(nullptr), m_buffer(static_cast<unsigned char*>(buffer)), m_buffer_size(size), m_destructors(nullptr) {}
+
+		// Returns `size` bytes aligned to `align` (a power of two).
+		// May throw std::bad_alloc when a new chunk is required.
+		inline void* allocate(std::size_t size, std::size_t align = alignof(std::max_align_t)) {
+			unsigned char* p = detail::scoped_arena::align_up(m_cursor, align);
+			if (!m_cursor || p > m_end || std::size_t(m_end - p) < size) {
+				std::size_t const extra = align > detail::scoped_arena::max_align ? align - 1 : 0;
+				if (size > std::size_t(-1) - extra) {
+					DETAIL_HNG_DEFER_THROW(std::bad_alloc());
+				}
+				p = detail::scoped_arena::align_up(next_region(size + extra), align);
+			}
+			m_cursor = p + size;
+			return p;
+		}
+
+		// Constructs a T in the arena.
+		// Unless T is trivially destructible, its destructor is registered and invoked when the arena is rolled back past it.
+		// If the allocation or the constructor throws, the memory is released and the exception is propagated.
+		template<class T, class... Args>
+		inline T* make(Args&&... args) {
+			static_assert(std::is_nothrow_destructible_v<T>, "objects in the arena must be nothrow destructible");
+			marker const before = mark();
+			bool constructed = false;
+			auto const rewind_on_failure = [&]()noexcept {
+				if (!constructed) {
+					rewind(before);
+				}
+			};
+			hng::defer<decltype(rewind_on_failure)> const rewind_on_failure_defer(rewind_on_failure);
+			void* node = nullptr;
+			if constexpr (!std::is_trivially_destructible_v<T>) {
+				node = allocate(sizeof(detail::scoped_arena::destructor), alignof(detail::scoped_arena::destructor));
+			}
+			void* const p = allocate(sizeof(T), alignof(T));
+			T* const object = ::new (p) T(std::forward<Args>(args)...);
+			if constexpr (!std::is_trivially_destructible_v<T>) {
+				m_destructors = ::new (node) detail::scoped_arena::destructor{ m_destructors, &detail::scoped_arena::destroy<T>, object };
+			}
+			constructed = true;
+			return object;
+		}
+
+		inline marker mark() const noexcept { return marker{ m_chunk, m_cursor, m_destructors }; }
+
+		// Destroys the objects created after `m`, in reverse order, and releases the memory allocated after `m`, in O(1).
+		// Marks taken after `m` are invalidated.
+		inline void rewind(marker const& m) noexcept {
+			while (m_destructors != m.m_destructors) {
+				detail::scoped_arena::destructor* const d = m_destructors;
+				m_destructors = d->m_prev;
+				d->m_destroy(d->m_object);
+			}
+			m_chunk = m.m_chunk;
+			m_cursor = m.m_cursor;
+			m_end = m_chunk ? detail::scoped_arena::chunk_data(m_chunk) + m_chunk->m_size : m_buffer + m_buffer_size;
+		}
+
+		// Rolls the arena back to empty. Chunks are kept for reuse.
+		inline void reset() noexcept { rewind(marker{ nullptr, m_buffer, nullptr }); }
+
+		// The number of bytes held in heap allocated chunks.
+		inline std::size_t capacity() const noexcept {
+			std::size_t total = 0;
+			for (detail::scoped_arena::chunk* c = m_first; c; c = c->m_next) {
+				total += c->m_size;
+			}
+			return total;
+		}
+	};
+
+	// Allocator adaptor for standard containers. Deallocation is a no-op: the memory is given back by the arena's rollback,
+	// so a container using it must be destroyed before the arena is rolled back past its allocations.
+	template<class T>
+	class arena_allocator
+	{
+	private:
+		template<class U>
+		friend class arena_allocator;
+		hng::arena* m_arena;
+
+	public:
+		using value_type = T;
+
+		inline explicit arena_allocator(hng::arena& a) noexcept : m_arena(&a) {}
+		template<class U>
+		inline arena_allocator(arena_allocator<U> const& other) noexcept : m_arena(other.m_arena) {}
+
+		inline T* allocate(std::size_t n) {
+			if (n > std::size_t(-1) / sizeof(T)) {
+				DETAIL_HNG_DEFER_THROW(std::bad_array_new_length());
+			}
+			return static_cast<T*>(m_arena->allocate(n * sizeof(T), alignof(T)));
+		}
+		inline void deallocate(T*, std::size_t) noexcept {}
+
+		inline hng::arena& get_arena() const noexcept { return *m_arena; }
+
+		// Allocators compare equal when they use the same arena, whatever their value types.
+		template<class U>
+		friend inline bool operator==(arena_allocator const& a, arena_allocator<U> const& b) noexcept { return &a.get_arena() == &b.get_arena(); }
+		template<class U>
+		friend inline bool operator!=(arena_allocator const& a, arena_allocator<U> const& b) noexcept { return !(a == b); }
+	};
+
+	// Takes a mark of the arena when it is constructed, and rolls the arena back to it at the end of the scope.
+	// Scopes nest: allocate through the innermost scope, since an outer scope's allocations made while
+	// an inner scope is alive are released by the inner scope's rollback.
+	class scoped_arena
+	{
+	private:
+		struct rollback
+		{
+			hng::arena* m_arena;
+			hng::arena::marker m_mark;
+			inline void operator()() const noexcept { m_arena->rewind(m_mark); }
+		};
+
+		hng::arena& m_arena;
+		hng::defer<rollback> const m_rollback;
+
+	public:
+		inline scoped_arena(scoped_arena const&) = delete;
+		inline scoped_arena(scoped_arena&&) = delete;
+		inline scoped_arena& operator=(scoped_arena const&) = delete;
+		inline scoped_arena& operator=(scoped_arena&&) = delete;
+		inline explicit scoped_arena(hng::arena& a) noexcept : m_arena(a), m_rollback(rollback{ &a, a.mark() }) {}
+		inline explicit scoped_arena(scoped_arena& parent) noexcept : scoped_arena(parent.get_arena()) {}
+
+		inline void* allocate(std::size_t size, std::size_t align = alignof(std::max_align_t)) { return m_arena.allocate(size, align); }
+
+		template<class T, class... Args>
+		inline T* make(Args&&... args) { return m_arena.make<T>(std::forward<Args>(args)...); }
+
+		template<class T>
+		inline arena_allocator<T> allocator() const noexcept { return arena_allocator<T>(m_arena); }
+
+		inline hng::arena& get_arena() const noexcept { return m_arena; }
+	};
+}
+
+#endif // ^^^ HNG_SCOPED_ARENA_HEADERGUARD
@@ -0,0 +1,210 @@
+#ifndef HNG_SHUTDOWN_DEFER_HEADERGUARD
+#define HNG_SHUTDOWN_DEFER_HEADERGUARD
+//
+//	Licence:	MIT
+//	GitHub:		https://github.com/highestnamegames/defer
+//	Version:	v1.1.0
+//
+//	Summary:
+//		Defers a callable to the shutdown of the process.
+//		Each cleanup is registered as essential (flushing a journal, fsyncing data) or skippable
+//		(freeing memory and closing descriptors which the OS reclaims anyway), with a priority.
+//		At a normal exit every cleanup runs, by decreasing priority; hng::fast_exit only runs the essential ones
+//		and then terminates the process with std::_Exit, without running destructors.
+//		Registration is lock-free: cleanups are pushed onto an intrusive list with a compare-and-swap.
+//		Compatible with C++17.
+//
+//	Example:
+//		```
+//			hng::shutdown_defer([&journal]()noexcept{ journal.flush(); }, hng::shutdown_cleanup::essential, 10);
+//			hng::shutdown_defer([cache]()noexcept{ delete cache; }, hng::shutdown_cleanup::skippable);
+//			// ...
+//			hng::fast_exit(0); // flushes the journal, skips freeing the cache
+//		```
+//
+
+#include <atomic>
+#include <cstdlib>
+#include <type_traits>
+#include <utility>
+#include <hng/defer/defer_core.h>
+
+namespace hng {
+
+	// Whether a cleanup runs when the process exits with hng::fast_exit.
+	enum class shutdown_cleanup
+	{
+		// Runs at every shutdown.
+		essential,
+		// Skipped by hng::fast_exit, and only run at a normal exit.
+		skippable
+	};
+
+	enum class shutdown_mode
+	{
+		// Runs every cleanup.
+		full,
+		// Runs the essential cleanups only.
+		fast
+	};
+
+	namespace detail {
+		namespace shutdown {
+
+			struct node
+			{
+				node* m_next;
+				// Invokes the callable and releases the node.
+				void (*m_run)(node*) noexcept;
+				int m_priority;
+				::hng::shutdown_cleanup m_kind;
+			};
+
+			template<class Callable>
+			struct callable_node : node
+			{
+				Callable m_callable;
+
+				template<class C>
+				inline callable_node(C&& callable, int priority, ::hng::shutdown_cleanup kind)
+					: node{ nullptr, &callable_node::run, priority, kind }, m_callable(std::forward<C>(callable)) {}
+
+				static inline void run(node* n) noexcept {
+					callable_node* const self = static_cast<callable_node*>(n);
+					std::move(self->m_callable)();
+					delete self;
+				}
+			};
+
+			// Constant initialized and trivially destructible, so it is usable from any static destructor.
+			struct registry
+			{
+				std::atomic<node*> m_head{ nullptr };
+				// 0 while the process is running, otherwise 1 + the shutdown_mode of the shutdown in progress.
+				std::atomic<int> m_state{ 0 };
+			};
+
+			inline registry& instance() noexcept {
+				static registry r;
+				return r;
+			}
+
+			// Merges two lists sorted by decreasing priority; on equal priorities the nodes of `a` come first.
+			inline node* merge(node* a, node* b) noexcept {
+				node* head = nullptr;
+				node** tail = &head;
+				while (a && b) {
+					node*& from = b->m_priority > a->m_priority ? b : a;
+					*tail = from;
+					tail = &from->m_next;
+					from = from->m_next;
+				}
+				*tail = a ? a : b;
+				return head;
+			}
+
+			// Stable merge sort by decreasing priority. The list is newest first, so equal priorities run in reverse order
+			// of registration, like nested hng::defer scopes. No memory is allocated.
+			inline node* sort(node* list) noexcept {
+				if (!list || !list->m_next)
+					return list;
+				node* slow = list;
+				for (node* fast = list->m_next; fast && fast->m_next; fast = fast->m_next->m_next) {
+					slow = slow->m_next;
+				}
+				node* const second = slow->m_next;
+				slow->m_next = nullptr;
+				return merge(sort(list), sort(second));
+			}
+
+			// Runs the registered cleanups until none is left. In fast mode the skippable nodes are dropped:
+			// neither invoked nor released, since the process is about to end.
+			inline void drain(registry& r, ::hng::shutdown_mode mode) noexcept {
+				while (node* list = r.m_head.exchange(nullptr, std::memory_order_seq_cst)) {
+					list = sort(list);
+					while (list) {
+						node* const n = list;
+						list = n->m_next;
+						if (mode == ::hng::shutdown_mode::full || n->m_kind == ::hng::shutdown_cleanup::essential) {
+							n->m_run(n);
+						}
+					}
+				}
+			}
+
+			inline void run(::hng::shutdown_mode mode) noexcept {
+				registry& r = instance();
+				r.m_state.store(1 + static_cast<int>(mode), std::memory_order_seq_cst);
+				drain(r, mode);
+			}
+
+			struct exit_hook
+			{
+				inline ~exit_hook() noexcept { run(::hng::shutdown_mode::full); }
+			};
+
+			// The hook is constructed by the first registration, so the cleanups run when the static objects
+			// constructed before that registration are destroyed (like a std::atexit handler registered then).
+			inline void register_exit_hook() noexcept {
+				static exit_hook const hook;
+				static_cast<void>(hook);
+			}
+
+		}
+	}
+
+	// Registers a cleanup to run at the shutdown of the process.
+	// Cleanups run by decreasing `priority`, and in reverse order of registration within a priority.
+	// A cleanup registered once the shutdown has begun (by another cleanup, or by another thread) is invoked immediately,
+	// unless it is skippable and the shutdown is a fast exit.
+	// Such late cleanups run on the registering thread: when it is not the shutting down thread, they run concurrently
+	// with the shutdown's cleanups and are not ordered by priority with them, and a fast exit may end the process
+	// before they complete. Register cleanups from other threads before the shutdown begins, or join those threads first.
+	// Registration does not take a lock; it allocates the node with new, and throws std::bad_alloc
+	// (or whatever copying/moving the callable throws) without registering it.
+	template<class Callable>
+	#if (defined(__cpp_concepts) && __cpp_concepts >= 201907L)
+	requires (noexcept(std::declval<std::decay_t<Callable>&&>()()))
+	#endif
+	inline void shutdown_defer(Callable&& callable, shutdown_cleanup kind, int priority = 0) {
+		detail::shutdown::registry& r = detail::shutdown::instance();
+		auto const run_now = [&](int state) {
+			if (kind == shutdown_cleanup::essential || state == 1 + static_cast<int>(shutdown_mode::full)) {
+				std::decay_t<Callable> local(std::forward<Callable>(callable));
+				std::move(local)();
+			}
+		};
+		int const state = r.m_state.load(std::memory_order_acquire);
+		if (state != 0) {
+			run_now(state);
+			return;
+		}
+		detail::shutdown::register_exit_hook();
+		detail::shutdown::node* const n = new detail::shutdown::callable_node<std::decay_t<Callable>>(std::forward<Callable>(callable), priority, kind);
+		n->m_next = r.m_head.load(std::memory_order_relaxed);
+		while (!r.m_head.compare_exchange_weak(n->m_next, n, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+		}
+		// If the shutdown began while the node was pushed, the shutting down thread may have drained the list already.
+		int const after = r.m_state.load(std::memory_order_seq_cst);
+		if (after != 0) {
+			detail::shutdown::drain(r, static_cast<shutdown_mode>(after - 1));
+		}
+	}
+
+	// Runs the registered cleanups now, on the calling thread: all of them, or only the essential ones.
+	// Cleanups registered afterwards are invoked immediately (see hng::shutdown_defer).
+	// Called with shutdown_mode::full when the static objects are destroyed at a normal exit.
+	inline void run_shutdown_cleanups(shutdown_mode mode = shutdown_mode::full) noexcept {
+		detail::shutdown::run(mode);
+	}
+
+	// Runs the essential cleanups, then terminates the process with std::_Exit(status) (_exit on POSIX systems):
+	// skippable cleanups, destructors of static objects and std::atexit handlers do not run,
+	// and C stdio buffers are not flushed (register std::fflush(nullptr) as an essential cleanup if needed).
+	[[noreturn]] inline void fast_exit(int status) noexcept {
+		detail::shutdown::run(shutdown_mode::fast);
+		std::_Exit(status);
+	}
+}
+
+#endif // ^^^ HNG_SHUTDOWN_DEFER_HEADERGUARD
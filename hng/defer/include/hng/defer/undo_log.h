@@ -0,0 +1,129 @@
+#ifndef HNG_UNDO_LOG_HEADERGUARD
+#define HNG_UNDO_LOG_HEADERGUARD
+//
+//	Licence:	MIT
+//	GitHub:		https://github.com/highestnamegames/defer
+//	Version:	v1.1.0
+//
+//	Summary:
+//		A transactional log of undo actions for multi-step updates.
+//		Undo actions are recorded in an arena. They are invoked in LIFO order to roll back,
+//		either entirely or to a savepoint. The log is rolled back automatically if it
+//		leaves the scope without being committed, and commit() discards the log in O(1).
+//
+//	Example:
+//		```
+//			hng::undo_log log;
+//			index.insert(key, value);
+//			log.record([&index, key]()noexcept{ index.erase(key); });
+//			auto const before_stats = log.savepoint();
+//			try {
+//				stats.update(key, log); // records its own undo actions
+//			}
+//			catch (stats_overflow const&) {
+//				log.rollback_to(before_stats); // keeps the insert
+//			}
+//			log.set(version, version + 1);
+//			log.commit();
+//		```
+//
+
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+#include <hng/defer/defer_stack.h>
+
+namespace hng {
+
+	// Undo actions are stored inline for the first `InlineBytes` bytes, then in heap allocated chunks
+	// which are kept for reuse.
+	// Undo actions must be noexcept and trivially destructible, so that commit() never runs a destructor.
+	template<std::size_t InlineBytes>
+	class basic_undo_log
+	{
+	private:
+		detail::defer_stack::arena<InlineBytes> m_arena;
+		detail::defer_stack::entry* m_top;
+		std::size_t m_size;
+
+		inline void undo_until(detail::defer_stack::entry* top) noexcept {
+			while (m_top != top && m_top) {
+				detail::defer_stack::entry* const e = m_top;
+				m_top = e->m_prev;
+				--m_size;
+				e->m_fn(e, true);
+				m_arena.rewind(e);
+			}
+		}
+
+	public:
+		// A position in the log. Rolling back to it undoes only the actions recorded after it was taken.
+		class savepoint_type
+		{
+		private:
+			friend class basic_undo_log;
+			detail::defer_stack::entry* m_top;
+			std::size_t m_size;
+			inline savepoint_type(detail::defer_stack::entry* top, std::size_t size) noexcept : m_top(top), m_size(size) {}
+		};
+
+		inline ~basic_undo_log() noexcept { rollback(); }
+		inline basic_undo_log(basic_undo_log const&) = delete;
+		inline basic_undo_log(basic_undo_log&&) = delete;
+		inline basic_undo_log& operator=(basic_undo_log const&) = delete;
+		inline basic_undo_log& operator=(basic_undo_log&&) = delete;
+		inline basic_undo_log() noexcept : m_arena(), m_top(nullptr), m_size(0) {}
+
+		// Records an undo action.
+		// If the action cannot be stored (allocation or construction throws),
+		// nothing is recorded and the exception is propagated.
+		template<class Callable>
+		inline void record(Callable&& callable) {
+			using F = std::decay_t<Callable>;
+			static_assert(noexcept(std::declval<F&&>()()), "the undo action must be noexcept");
+			static_assert(std::is_trivially_destructible<F>::value, "the undo action must be trivially destructible");
+			static_assert(alignof(F) <= alignof(std::max_align_t), "over-aligned undo actions are not supported");
+
+			m_top = detail::defer_stack::push_entry(m_arena, m_top, std::forward<Callable>(callable));
+			++m_size;
+		}
+
+		// Assigns `value` to `target`, and records an undo action which restores the previous value.
+		template<class T, class U>
+		inline void set(T& target, U&& value) {
+			static_assert(std::is_trivially_copyable<T>::value, "set() requires a trivially copyable target");
+			T const previous = target;
+			T* const target_ptr = &target;
+			record([target_ptr, previous]()noexcept { *target_ptr = previous; });
+			target = std::forward<U>(value);
+		}
+
+		inline savepoint_type savepoint() const noexcept { return savepoint_type(m_top, m_size); }
+
+		// Undoes the actions recorded after the savepoint, in LIFO order. The savepoint stays valid.
+		// The savepoint must have been taken since the last commit() or rollback(),
+		// and the actions recorded before it must not have been rolled back since.
+		inline void rollback_to(savepoint_type const& sp) noexcept {
+			if (sp.m_size <= m_size) {
+				undo_until(sp.m_top);
+			}
+		}
+
+		// Undoes every recorded action, in LIFO order.
+		inline void rollback() noexcept { undo_until(nullptr); }
+
+		// Discards every recorded action without invoking it, in O(1).
+		inline void commit() noexcept {
+			m_top = nullptr;
+			m_size = 0;
+			m_arena.reset();
+		}
+
+		inline bool empty() const noexcept { return m_top == nullptr; }
+		inline std::size_t size() const noexcept { return m_size; }
+	};
+
+	using undo_log = basic_undo_log<512>;
+}
+
+#endif // ^^^ HNG_UNDO_LOG_HEADERGUARD
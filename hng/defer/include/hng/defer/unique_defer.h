@@ -0,0 +1,144 @@
+#ifndef HNG_UNIQUE_DEFER_HEADERGUARD
+#define HNG_UNIQUE_DEFER_HEADERGUARD
+//
+//	Licence:	MIT
+//	GitHub:		https://github.com/highestnamegames/defer
+//	Version:	v1.1.0
+//
+//	Summary:
+//		A movable, type-erased deferred callable, which can be returned from factories and stored in containers.
+//		The callable is stored in a fixed inline buffer (3 pointers by default) and never on the heap;
+//		a callable which does not fit is rejected at compile time.
+//		Invoking the callable costs one indirect call more than hng::defer.
+//		Compatible with C++17.
+//
+//	Example:
+//		```
+//			hng::unique_defer lock_file(int fd) {
+//				::flock(fd, LOCK_EX);
+//				return hng::unique_defer([fd]()noexcept{ ::flock(fd, LOCK_UN); });
+//			}
+//			std::vector<hng::unique_defer> locks;
+//			locks.push_back(lock_file(fd));
+//		```
+//
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace hng {
+	namespace detail {
+		namespace unique_defer {
+
+			enum class operation
+			{
+				// Invokes the callable at `self`, then destroys it.
+				invoke,
+				// Move constructs the callable at `other` from the callable at `self`, then destroys the callable at `self`.
+				relocate,
+				// Destroys the callable at `self` without invoking it.
+				destroy,
+			};
+
+			using manager_fn = void (*)(operation op, void* self, void* other) noexcept;
+
+			template<class Callable>
+			struct manager
+			{
+				static inline void fn(operation op, void* self, void* other) noexcept {
+					Callable* const callable = std::launder(static_cast<Callable*>(self));
+					switch (op) {
+					case operation::invoke:
+						std::move(*callable)();
+						break;
+					case operation::relocate:
+						::new (other) Callable(std::move(*callable));
+						break;
+					case operation::destroy:
+						break;
+					}
+					callable->~Callable();
+				}
+			};
+
+		}
+	}
+
+	// Holds a callable of at most `Capacity` bytes and `Align` alignment, in an inline buffer.
+	// The callable is invoked when the unique_defer is destroyed or assigned to, unless it has been released.
+	// A moved-from unique_defer is empty.
+	template<std::size_t Capacity, std::size_t Align = alignof(void*)>
+	class basic_unique_defer
+	{
+	private:
+		alignas(Align) unsigned char m_storage[Capacity];
+		detail::unique_defer::manager_fn m_manager;
+
+		inline void take(basic_unique_defer& other) noexcept {
+			if (other.m_manager) {
+				other.m_manager(detail::unique_defer::operation::relocate, other.m_storage, m_storage);
+				m_manager = other.m_manager;
+				other.m_manager = nullptr;
+			}
+		}
+
+	public:
+		// True if a unique_defer can be constructed from `Callable`.
+		template<class Callable>
+		static constexpr bool fits =
+			sizeof(std::decay_t<Callable>) <= Capacity
+			&& alignof(std::decay_t<Callable>) <= Align
+			&& std::is_nothrow_move_constructible_v<std::decay_t<Callable>>
+			&& std::is_nothrow_invocable_v<std::decay_t<Callable>&&>;
+
+		inline ~basic_unique_defer() noexcept { reset(); }
+		inline basic_unique_defer(basic_unique_defer const&) = delete;
+		inline basic_unique_defer& operator=(basic_unique_defer const&) = delete;
+		inline basic_unique_defer() noexcept : m_manager(nullptr) {}
+		inline basic_unique_defer(basic_unique_defer&& other) noexcept : m_manager(nullptr) { take(other); }
+
+		// Invokes the held callable, if any, then takes the callable of `other`.
+		inline basic_unique_defer& operator=(basic_unique_defer&& other) noexcept {
+			if (this != &other) {
+				reset();
+				take(other);
+			}
+			return *this;
+		}
+
+		template<class Callable, typename EIF = std::enable_if_t<!std::is_same_v<std::decay_t<Callable>, basic_unique_defer>, void>>
+		inline explicit basic_unique_defer(Callable&& callable) noexcept(std::is_nothrow_constructible_v<std::decay_t<Callable>, Callable&&>) : m_manager(nullptr) {
+			using F = std::decay_t<Callable>;
+			static_assert(sizeof(F) <= Capacity, "the callable does not fit in the inline buffer of the unique_defer");
+			static_assert(alignof(F) <= Align, "the callable is over-aligned for the inline buffer of the unique_defer");
+			static_assert(std::is_nothrow_move_constructible_v<F>, "the callable must be nothrow move constructible");
+			static_assert(std::is_nothrow_invocable_v<F&&>, "the callable must be noexcept");
+			::new (static_cast<void*>(m_storage)) F(std::forward<Callable>(callable));
+			m_manager = &detail::unique_defer::manager<F>::fn;
+		}
+
+		// Invokes the held callable now, if any, and empties the unique_defer.
+		inline void reset() noexcept {
+			if (detail::unique_defer::manager_fn const manager = m_manager) {
+				m_manager = nullptr;
+				manager(detail::unique_defer::operation::invoke, m_storage, nullptr);
+			}
+		}
+
+		// Destroys the held callable without invoking it, and empties the unique_defer.
+		inline void release() noexcept {
+			if (detail::unique_defer::manager_fn const manager = m_manager) {
+				m_manager = nullptr;
+				manager(detail::unique_defer::operation::destroy, m_storage, nullptr);
+			}
+		}
+
+		inline explicit operator bool() const noexcept { return m_manager != nullptr; }
+	};
+
+	using unique_defer = basic_unique_defer<3 * sizeof(void*)>;
+}
+
+#endif // ^^^ HNG_UNIQUE_DEFER_HEADERGUARD
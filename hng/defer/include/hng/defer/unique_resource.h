@@ -0,0 +1,188 @@
+#ifndef HNG_UNIQUE_RESOURCE_HEADERGUARD
+#define HNG_UNIQUE_RESOURCE_HEADERGUARD
+//
+//	Licence:	MIT
+//	GitHub:		https://github.com/highestnamegames/defer
+//	Version:	v1.1.0
+//
+//	Summary:
+//		A typed handle which releases its resource with a deleter at the end of the scope.
+//		The handle is stored by value, so it can stay in a register instead of being captured by reference,
+//		and a stateless deleter takes no space (empty base optimization): sizeof(hng::unique_fd) == sizeof(int).
+//		The empty state is a sentinel value of the handle type (for example -1 for a file descriptor),
+//		so no flag is stored either.
+//		Unlike hng::defer it stores no callable: the handle and the deleter are its whole state,
+//		and the destructor invokes the deleter on the handle directly.
+//		Includes hng::unique_fd and hng::unique_mmap on POSIX systems.
+//		Compatible with C++17.
+//
+//	Example:
+//		```
+//			hng::unique_fd const fd(::open(path, O_RDONLY));
+//			if (!fd)
+//				return false;
+//			hng::unique_mmap const region = hng::make_unique_mmap(size, PROT_READ, MAP_PRIVATE, fd.get(), 0);
+//		```
+//
+
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+#if (defined(__unix__) || defined(__APPLE__)) && __has_include(<unistd.h>) && __has_include(<sys/mman.h>)
+#define DETAIL_HNG_UNIQUE_RESOURCE_HAS_POSIX 1
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <unistd.h>
+#else
+#define DETAIL_HNG_UNIQUE_RESOURCE_HAS_POSIX 0
+#endif
+
+namespace hng {
+	namespace detail {
+		namespace unique_resource {
+
+			// Holds the deleter as a base class when it is empty, so that it takes no space.
+			template<class Deleter, bool = std::is_empty_v<Deleter> && !std::is_final_v<Deleter>>
+			struct deleter_storage : private Deleter
+			{
+				inline deleter_storage() noexcept(std::is_nothrow_default_constructible_v<Deleter>) : Deleter() {}
+				inline explicit deleter_storage(Deleter&& deleter) noexcept : Deleter(std::move(deleter)) {}
+				inline Deleter& deleter() noexcept { return *this; }
+				inline Deleter const& deleter() const noexcept { return *this; }
+			};
+
+			template<class Deleter>
+			struct deleter_storage<Deleter, false>
+			{
+				Deleter m_deleter;
+				inline deleter_storage() noexcept(std::is_nothrow_default_constructible_v<Deleter>) : m_deleter() {}
+				inline explicit deleter_storage(Deleter&& deleter) noexcept : m_deleter(std::move(deleter)) {}
+				inline Deleter& deleter() noexcept { return m_deleter; }
+				inline Deleter const& deleter() const noexcept { return m_deleter; }
+			};
+
+			template<class Resource, class Deleter, class = void>
+			struct has_invalid : std::false_type {};
+
+			template<class Resource, class Deleter>
+			struct has_invalid<Resource, Deleter, std::void_t<decltype(Resource(Deleter::invalid()))>> : std::true_type {};
+
+			// `Deleter::invalid()` if the deleter declares it, otherwise a value initialized resource.
+			template<class Resource, class Deleter>
+			inline constexpr Resource invalid() noexcept {
+				if constexpr (has_invalid<Resource, Deleter>::value) {
+					return Resource(Deleter::invalid());
+				}
+				else {
+					return Resource();
+				}
+			}
+
+		}
+	}
+
+	// Owns a `Resource` handle, and invokes `Deleter` on it when the unique_resource is destroyed or reset.
+	// The empty state is the sentinel value `Deleter::invalid()` if the deleter declares it,
+	// otherwise a value initialized `Resource` (0, nullptr); the deleter is never invoked on it.
+	// The deleter must be noexcept and nothrow move constructible, and the resource nothrow movable.
+	template<class Resource, class Deleter>
+	class unique_resource : private detail::unique_resource::deleter_storage<Deleter>
+	{
+	private:
+		using storage = detail::unique_resource::deleter_storage<Deleter>;
+		Resource m_resource;
+
+		static_assert(std::is_nothrow_invocable_v<Deleter&, Resource const&>, "the deleter must be noexcept");
+		static_assert(std::is_nothrow_move_constructible_v<Deleter>, "the deleter must be nothrow move constructible");
+		static_assert(std::is_nothrow_move_constructible_v<Resource> && std::is_nothrow_move_assignable_v<Resource>, "the resource must be nothrow movable");
+
+	public:
+		// True if relocating a unique_resource (moving it and destroying the source) is equivalent to copying its bytes,
+		// so containers and arrays of handles may be relocated with memcpy.
+		static constexpr bool is_trivially_relocatable = std::is_trivially_copyable_v<Resource> && std::is_trivially_copyable_v<Deleter>;
+
+		static inline constexpr Resource invalid() noexcept { return detail::unique_resource::invalid<Resource, Deleter>(); }
+
+		inline ~unique_resource() noexcept { reset(); }
+		inline unique_resource(unique_resource const&) = delete;
+		inline unique_resource& operator=(unique_resource const&) = delete;
+		inline unique_resource() noexcept(std::is_nothrow_default_constructible_v<Deleter>) : storage(), m_resource(invalid()) {}
+		inline explicit unique_resource(Resource resource) noexcept(std::is_nothrow_default_constructible_v<Deleter>) : storage(), m_resource(std::move(resource)) {}
+		inline unique_resource(Resource resource, Deleter deleter) noexcept : storage(std::move(deleter)), m_resource(std::move(resource)) {}
+		inline unique_resource(unique_resource&& other) noexcept : storage(std::move(other.get_deleter())), m_resource(other.release()) {}
+
+		// Releases the owned resource, then takes the resource and the deleter of `other`.
+		// Requires a nothrow move assignable deleter.
+		inline unique_resource& operator=(unique_resource&& other) noexcept {
+			static_assert(std::is_nothrow_move_assignable_v<Deleter>, "move assignment requires a nothrow move assignable deleter");
+			if (this != &other) {
+				reset(other.release());
+				get_deleter() = std::move(other.get_deleter());
+			}
+			return *this;
+		}
+
+		inline Resource const& get() const noexcept { return m_resource; }
+		inline Deleter& get_deleter() noexcept { return storage::deleter(); }
+		inline Deleter const& get_deleter() const noexcept { return storage::deleter(); }
+		inline explicit operator bool() const noexcept { return !(m_resource == invalid()); }
+
+		// Releases the owned resource now, if any, and empties the unique_resource.
+		inline void reset() noexcept { reset(invalid()); }
+
+		// Releases the owned resource, if any, and takes ownership of `resource`.
+		inline void reset(Resource resource) noexcept {
+			Resource previous = std::exchange(m_resource, std::move(resource));
+			if (!(previous == invalid())) {
+				get_deleter()(previous);
+			}
+		}
+
+		// Gives up ownership of the resource without releasing it, and returns it.
+		inline Resource release() noexcept { return std::exchange(m_resource, invalid()); }
+	};
+
+#if DETAIL_HNG_UNIQUE_RESOURCE_HAS_POSIX
+
+	// Closes a POSIX file descriptor.
+	struct fd_deleter
+	{
+		static inline constexpr int invalid() noexcept { return -1; }
+		inline void operator()(int fd) const noexcept { ::close(fd); }
+	};
+
+	using unique_fd = unique_resource<int, fd_deleter>;
+
+	// A region mapped with mmap().
+	struct mmap_region
+	{
+		void* address;
+		std::size_t length;
+
+		inline unsigned char* data() const noexcept { return static_cast<unsigned char*>(address); }
+		friend inline constexpr bool operator==(mmap_region const& a, mmap_region const& b) noexcept { return a.address == b.address && a.length == b.length; }
+		friend inline constexpr bool operator!=(mmap_region const& a, mmap_region const& b) noexcept { return !(a == b); }
+	};
+
+	// Unmaps a region mapped with mmap(). The empty region is { MAP_FAILED, 0 }.
+	struct mmap_deleter
+	{
+		static inline mmap_region invalid() noexcept { return mmap_region{ MAP_FAILED, 0 }; }
+		inline void operator()(mmap_region const& region) const noexcept { ::munmap(region.address, region.length); }
+	};
+
+	using unique_mmap = unique_resource<mmap_region, mmap_deleter>;
+
+	// Maps a region with mmap(). Returns an empty unique_mmap if mmap() fails (errno is set by mmap()).
+	inline unique_mmap make_unique_mmap(std::size_t length, int prot, int flags, int fd, off_t offset, void* address = nullptr) noexcept {
+		void* const mapped = ::mmap(address, length, prot, flags, fd, offset);
+		if (mapped == MAP_FAILED)
+			return unique_mmap();
+		return unique_mmap(mmap_region{ mapped, length });
+	}
+
+#endif // ^^^ DETAIL_HNG_UNIQUE_RESOURCE_HAS_POSIX
+}
+
+#endif // ^^^ HNG_UNIQUE_RESOURCE_HEADERGUARD
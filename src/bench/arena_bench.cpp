@@ -0,0 +1,80 @@
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+#include <hng/defer/scoped_arena.h>
+#include "bench.h"
+
+// Request-shaped workloads: each operation handles one request which makes N short-lived allocations
+// and releases all of them at its end.
+//   alloc:  N allocations of 16 to 256 bytes, freed one by one with free() against rolled back by hng::scoped_arena.
+//   tokens: a vector of N tokens grown by push_back, with std::allocator against hng::arena_allocator.
+
+namespace hng {
+    namespace defer_bench {
+        namespace {
+
+            struct token {
+                std::uint32_t kind;
+                std::uint32_t offset;
+                std::uint32_t length;
+            };
+
+            // Sizes of 16 to 256 bytes, the same sequence for every request.
+            std::size_t allocation_size(int i) {
+                return 16 + std::size_t((i * 2654435761u) >> 24) % 241;
+            }
+
+            HNG_DEFER_BENCH_NOINLINE void alloc_malloc_free(int n, std::vector<void*>& pointers) {
+                for (int i = 0; i < n; ++i) {
+                    void* const p = std::malloc(allocation_size(i));
+                    do_not_optimize(p);
+                    pointers[std::size_t(i)] = p;
+                }
+                for (int i = 0; i < n; ++i) {
+                    std::free(pointers[std::size_t(i)]);
+                }
+            }
+
+            HNG_DEFER_BENCH_NOINLINE void alloc_scoped_arena(int n, hng::arena& arena) {
+                hng::scoped_arena const scope(arena);
+                for (int i = 0; i < n; ++i) {
+                    void* const p = arena.allocate(allocation_size(i));
+                    do_not_optimize(p);
+                }
+            }
+
+            template<class Vector>
+            HNG_DEFER_BENCH_NOINLINE void fill_tokens(Vector& tokens, int n) {
+                for (int i = 0; i < n; ++i) {
+                    tokens.push_back(token{ std::uint32_t(i & 7), std::uint32_t(i * 4), 4 });
+                }
+                do_not_optimize(tokens.back());
+            }
+
+            HNG_DEFER_BENCH_NOINLINE void tokens_std_allocator(int n) {
+                std::vector<token> tokens;
+                fill_tokens(tokens, n);
+            }
+
+            HNG_DEFER_BENCH_NOINLINE void tokens_arena_allocator(int n, hng::arena& arena) {
+                hng::scoped_arena const scope(arena);
+                std::vector<token, hng::arena_allocator<token>> tokens(scope.allocator<token>());
+                fill_tokens(tokens, n);
+            }
+
+        }
+
+        void run_arena_benchmarks(runner& r) {
+            for (int const n : { 16, 64, 256, 1024 }) {
+                std::vector<void*> pointers(std::size_t(n), nullptr);
+                r.run("arena", "alloc/malloc_free", n, [&] { alloc_malloc_free(n, pointers); });
+                hng::arena arena;
+                r.run("arena", "alloc/scoped_arena", n, [&] { alloc_scoped_arena(n, arena); });
+                r.run("arena", "tokens/std_allocator", n, [&] { tokens_std_allocator(n); });
+                r.run("arena", "tokens/arena_allocator", n, [&] { tokens_arena_allocator(n, arena); });
+            }
+        }
+
+    }
+}
@@ -0,0 +1,87 @@
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include <hng/defer/async_defer.h>
+#include "bench.h"
+
+// Latency of a scope which frees a 100 MiB structure (25600 blocks of 4 KiB) at its end:
+// freed inline by hng::defer, against handed to a background worker by hng::async_defer.
+// Building the structure is not timed, and the worker is flushed between samples.
+
+namespace hng {
+    namespace defer_bench {
+        namespace {
+
+            constexpr std::size_t block_size = 4096;
+            constexpr std::size_t block_count = 100 * 1024 * 1024 / block_size;
+
+            using structure = std::vector<std::unique_ptr<char[]>>;
+
+            std::unique_ptr<structure> build() {
+                auto s = std::make_unique<structure>();
+                s->reserve(block_count);
+                for (std::size_t i = 0; i < block_count; ++i) {
+                    s->emplace_back(new char[block_size]);
+                    std::memset(s->back().get(), int(i), block_size);
+                }
+                return s;
+            }
+
+            HNG_DEFER_BENCH_NOINLINE void use(structure const& s) {
+                do_not_optimize(s.front()[0]);
+            }
+
+            HNG_DEFER_BENCH_NOINLINE void sync_scope(std::unique_ptr<structure>& owned) {
+                structure const& view = *owned;
+                auto const release = [&owned]() noexcept { owned.reset(); };
+                hng::defer<decltype(release)> const release_defer(release);
+                use(view);
+            }
+
+            HNG_DEFER_BENCH_NOINLINE void async_scope(hng::async_defer_executor& executor, std::unique_ptr<structure>& owned) {
+                structure const& view = *owned;
+                hng::async_defer const release(executor, [owned = std::move(owned)]() mutable noexcept { owned.reset(); });
+                use(view);
+            }
+
+            double percentile(std::vector<double> const& sorted, double p) {
+                std::size_t const index = std::size_t(p * double(sorted.size() - 1) + 0.5);
+                return sorted[std::min(index, sorted.size() - 1)];
+            }
+
+            template<class Scope>
+            void run_latency(runner& r, char const* name, Scope&& scope, hng::async_defer_executor& executor) {
+                if (!r.enabled("async", name))
+                    return;
+                using clock = std::chrono::steady_clock;
+                int const samples = std::max(20, 10 * r.repetitions());
+                std::vector<double> latencies;
+                latencies.reserve(std::size_t(samples));
+                for (int i = 0; i < samples; ++i) {
+                    auto owned = build();
+                    auto const start = clock::now();
+                    scope(owned);
+                    latencies.push_back(std::chrono::duration<double, std::micro>(clock::now() - start).count());
+                    executor.flush();
+                }
+                std::sort(latencies.begin(), latencies.end());
+                r.add(result{ "async", name, 100, {
+                    { "p50_us", percentile(latencies, 0.50) },
+                    { "p99_us", percentile(latencies, 0.99) },
+                    { "max_us", latencies.back() },
+                    { "samples", double(samples) } } });
+            }
+
+        }
+
+        void run_async_benchmarks(runner& r) {
+            hng::async_defer_executor executor;
+            run_latency(r, "free_100MiB/hng::defer", [](std::unique_ptr<structure>& owned) { sync_scope(owned); }, executor);
+            run_latency(r, "free_100MiB/hng::async_defer", [&executor](std::unique_ptr<structure>& owned) { async_scope(executor, owned); }, executor);
+        }
+
+    }
+}
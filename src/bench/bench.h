@@ -0,0 +1,127 @@
+#ifndef HNG_DEFER_BENCH_HEADERGUARD
+#define HNG_DEFER_BENCH_HEADERGUARD
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifndef HNG_DEFER_BENCH_OPT
+#define HNG_DEFER_BENCH_OPT "unknown"
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#define HNG_DEFER_BENCH_NOINLINE __declspec(noinline)
+#else
+#define HNG_DEFER_BENCH_NOINLINE __attribute__((noinline))
+#endif
+
+namespace hng {
+    namespace defer_bench {
+
+        // Prevents the compiler from optimizing away the computation of `value`.
+        template<class T>
+        inline void do_not_optimize(T const& value) {
+#if defined(_MSC_VER) && !defined(__clang__)
+            static char const volatile* volatile sink;
+            sink = reinterpret_cast<char const volatile*>(&value);
+            std::atomic_signal_fence(std::memory_order_seq_cst);
+#else
+            asm volatile("" : : "r,m"(value) : "memory");
+#endif
+        }
+
+        // Forces the compiler to assume all memory may have been read and written.
+        inline void clobber_memory() {
+#if defined(_MSC_VER) && !defined(__clang__)
+            std::atomic_signal_fence(std::memory_order_seq_cst);
+#else
+            asm volatile("" : : : "memory");
+#endif
+        }
+
+        struct result {
+            std::string suite;
+            std::string name;
+            long long param = 0;
+            std::vector<std::pair<std::string, double>> metrics;
+        };
+
+        class runner {
+        private:
+            std::vector<result> m_results;
+            std::string m_filter;
+            std::chrono::nanoseconds m_min_time;
+            int m_repetitions;
+
+        public:
+            runner(std::string filter, std::chrono::nanoseconds min_time, int repetitions)
+                : m_filter(std::move(filter)), m_min_time(min_time), m_repetitions(repetitions) {}
+
+            std::vector<result> const& results() const noexcept { return m_results; }
+            std::chrono::nanoseconds min_time() const noexcept { return m_min_time; }
+            int repetitions() const noexcept { return m_repetitions; }
+
+            bool enabled(std::string const& suite, std::string const& name) const {
+                return m_filter.empty() || (suite + "/" + name).find(m_filter) != std::string::npos;
+            }
+
+            // Records a result measured by a custom benchmark (threads, latency percentiles, ...).
+            void add(result r);
+
+            // Measures the mean time of one call to `op`.
+            // The iteration count is doubled until a batch runs for at least min_time,
+            // and the fastest of the repetitions is recorded.
+            template<class Op>
+            void run(std::string const& suite, std::string const& name, long long param, Op&& op) {
+                if (!enabled(suite, name))
+                    return;
+                using clock = std::chrono::steady_clock;
+                std::uint64_t iterations = 1;
+                for (;;) {
+                    auto const start = clock::now();
+                    for (std::uint64_t i = 0; i < iterations; ++i) {
+                        op();
+                    }
+                    if (clock::now() - start >= m_min_time / 8 || iterations >= (std::uint64_t(1) << 40))
+                        break;
+                    iterations *= 2;
+                }
+                iterations *= 8;
+                double best = 0;
+                for (int rep = 0; rep < m_repetitions; ++rep) {
+                    auto const start = clock::now();
+                    for (std::uint64_t i = 0; i < iterations; ++i) {
+                        op();
+                    }
+                    double const ns = std::chrono::duration<double, std::nano>(clock::now() - start).count() / double(iterations);
+                    if (rep == 0 || ns < best)
+                        best = ns;
+                }
+                add(result{ suite, name, param, { { "ns_per_op", best }, { "iterations", double(iterations) } } });
+            }
+
+            void write_json(std::ostream& os) const;
+        };
+
+        // One function per benchmark suite, each defined in its own translation unit.
+        void run_scope_benchmarks(runner& r);
+        void run_bulk_benchmarks(runner& r);
+        void run_reclaimer_benchmarks(runner& r);
+        void run_async_benchmarks(runner& r);
+        void run_thread_exit_benchmarks(runner& r);
+        void run_exception_benchmarks(runner& r);
+        void run_parallel_benchmarks(runner& r);
+        void run_arena_benchmarks(runner& r);
+        void run_chain_benchmarks(runner& r);
+        void run_shutdown_benchmarks(runner& r);
+        void run_coalesce_benchmarks(runner& r);
+        void run_lock_benchmarks(runner& r);
+
+    }
+}
+
+#endif // ^^^ HNG_DEFER_BENCH_HEADERGUARD
@@ -0,0 +1,111 @@
+# Build-time benchmark: generates TUS translation units with SITES defer sites each,
+# for each header and construct, and measures the front-end time (-fsyntax-only)
+# and the object size (-c) of compiling them.
+#
+# Usage:
+#   cmake -DCOMPILER=<c++ compiler> -DINCLUDE_DIR=<dir> -DWORK_DIR=<dir>
+#         [-DFLAGS="<space separated flags>"] [-DTUS=<n>] [-DSITES=<m>] [-DOUT=<file.json>]
+#         -P build_bench.cmake
+
+if(NOT DEFINED FLAGS)
+  set(FLAGS "-std=c++17 -O2")
+endif()
+if(NOT DEFINED TUS)
+  set(TUS 20)
+endif()
+if(NOT DEFINED SITES)
+  set(SITES 50)
+endif()
+separate_arguments(flag_list UNIX_COMMAND "${FLAGS}")
+file(MAKE_DIRECTORY "${WORK_DIR}")
+
+# Each case is <name>|<header>|<construct>.
+set(cases
+  "none|<utility>|none"
+  "defer_core.h/HNG_DEFER_BLOCK|<hng/defer/defer_core.h>|block"
+  "defer.h/HNG_DEFER_BLOCK|<hng/defer/defer.h>|block"
+  "defer_try.h/HNG_DT_DEFER_FINALLY|<hng/defer/defer_try.h>|dt"
+  "defer_try.h/HNG_DT_DEFER_FINALLY_PRESERVE|<hng/defer/defer_try.h>|dt_preserve"
+)
+
+function(generate_site construct index out_var)
+  if(construct STREQUAL "none")
+    set(body "work(x); cleanup(x);")
+  elseif(construct STREQUAL "block")
+    set(body "HNG_DEFER_BLOCK({ cleanup(x); }); work(x);")
+  elseif(construct STREQUAL "dt")
+    set(body "HNG_DT_DEFER_FINALLY[&]{ cleanup(x); } HNG_DT_TRY[&]{ work(x); } HNG_DT_END;")
+  else()
+    set(body "HNG_DT_DEFER_FINALLY_PRESERVE[&]{ cleanup(x); } HNG_DT_TRY[&]{ work(x); } HNG_DT_END;")
+  endif()
+  set(${out_var} "void site_${index}(int x) { ${body} }\n" PARENT_SCOPE)
+endfunction()
+
+function(now_us out_var)
+  # Seconds followed by the six digits of microseconds.
+  string(TIMESTAMP value "%s%f")
+  set(${out_var} ${value} PARENT_SCOPE)
+endfunction()
+
+set(json_results "")
+math(EXPR last_tu "${TUS} - 1")
+math(EXPR last_site "${SITES} - 1")
+foreach(case IN LISTS cases)
+  string(REPLACE "|" ";" fields "${case}")
+  list(GET fields 0 name)
+  list(GET fields 1 header)
+  list(GET fields 2 construct)
+  string(MAKE_C_IDENTIFIER "${name}" case_dir)
+
+  set(sources "")
+  foreach(tu RANGE ${last_tu})
+    set(source "#include ${header}\nvoid cleanup(int) noexcept;\nvoid work(int);\nnamespace tu_${tu} {\n")
+    foreach(site RANGE ${last_site})
+      generate_site(${construct} ${site} site_source)
+      string(APPEND source "${site_source}")
+    endforeach()
+    string(APPEND source "}\n")
+    set(path "${WORK_DIR}/${case_dir}/tu_${tu}.cpp")
+    file(WRITE "${path}" "${source}")
+    list(APPEND sources "${path}")
+  endforeach()
+
+  set(frontend_us 0)
+  set(object_bytes 0)
+  foreach(source IN LISTS sources)
+    now_us(start)
+    execute_process(
+      COMMAND "${COMPILER}" ${flag_list} "-I${INCLUDE_DIR}" -fsyntax-only "${source}"
+      RESULT_VARIABLE result
+      ERROR_VARIABLE errors
+    )
+    now_us(stop)
+    if(NOT result EQUAL 0)
+      message(FATAL_ERROR "Failed to compile ${source}:\n${errors}")
+    endif()
+    math(EXPR frontend_us "${frontend_us} + ${stop} - ${start}")
+
+    execute_process(
+      COMMAND "${COMPILER}" ${flag_list} "-I${INCLUDE_DIR}" -c -o "${source}.o" "${source}"
+      RESULT_VARIABLE result
+      ERROR_VARIABLE errors
+    )
+    if(NOT result EQUAL 0)
+      message(FATAL_ERROR "Failed to compile ${source}:\n${errors}")
+    endif()
+    file(SIZE "${source}.o" size)
+    math(EXPR object_bytes "${object_bytes} + ${size}")
+  endforeach()
+
+  math(EXPR frontend_us_per_tu "${frontend_us} / ${TUS}")
+  math(EXPR object_bytes_per_site "${object_bytes} / (${TUS} * ${SITES})")
+  message(STATUS "build/${name}/${SITES}: frontend_us_per_tu=${frontend_us_per_tu} object_bytes=${object_bytes} object_bytes_per_site=${object_bytes_per_site}")
+  if(NOT json_results STREQUAL "")
+    string(APPEND json_results ",")
+  endif()
+  string(APPEND json_results "\n    {\"suite\": \"build\", \"name\": \"${name}\", \"param\": ${SITES}, \"tus\": ${TUS}, \"frontend_us\": ${frontend_us}, \"frontend_us_per_tu\": ${frontend_us_per_tu}, \"object_bytes\": ${object_bytes}, \"object_bytes_per_site\": ${object_bytes_per_site}}")
+endforeach()
+
+if(DEFINED OUT)
+  file(WRITE "${OUT}" "{\n  \"compiler\": \"${COMPILER}\",\n  \"flags\": \"${FLAGS}\",\n  \"results\": [${json_results}\n  ]\n}\n")
+endif()
@@ -0,0 +1,86 @@
+
+#include <cstdint>
+#include <vector>
+#include <hng/defer/defer.h>
+#include <hng/defer/defer_stack.h>
+#include <hng/defer/bulk_defer.h>
+#include "bench.h"
+
+// Releases N pool slots at the end of a scope:
+// one deferred call per slot (hng::defer_stack) against one batched call per 64 slots (hng::bulk_defer).
+
+namespace hng {
+    namespace defer_bench {
+        namespace {
+
+            class slot_pool {
+            private:
+                std::vector<std::uint32_t> m_free;
+            public:
+                explicit slot_pool(std::uint32_t capacity) {
+                    m_free.reserve(capacity);
+                    for (std::uint32_t i = capacity; i-- > 0;) {
+                        m_free.push_back(i);
+                    }
+                }
+
+                std::uint32_t acquire() noexcept {
+                    std::uint32_t const slot = m_free.back();
+                    m_free.pop_back();
+                    return slot;
+                }
+
+                HNG_DEFER_BENCH_NOINLINE void release(std::uint32_t slot) noexcept {
+                    m_free.push_back(slot);
+                }
+
+                HNG_DEFER_BENCH_NOINLINE void release(std::uint32_t const* slots, std::size_t count) noexcept {
+                    m_free.insert(m_free.end(), slots, slots + count);
+                }
+            };
+
+            void per_slot_defer(slot_pool& pool, int n) {
+                hng::basic_defer_stack<16 * 1024> cleanup;
+                for (int i = 0; i < n; ++i) {
+                    std::uint32_t const slot = pool.acquire();
+                    cleanup.push([&pool, slot]()noexcept { pool.release(slot); });
+                    do_not_optimize(slot);
+                }
+            }
+
+            void bulk_slot_defer(slot_pool& pool, int n) {
+                auto const release = [&pool](hng::bulk_span<std::uint32_t> slots)noexcept {
+                    pool.release(slots.data(), slots.size());
+                };
+                hng::bulk_defer<std::uint32_t, 64, decltype(release)> slots_defer(release);
+                for (int i = 0; i < n; ++i) {
+                    std::uint32_t const slot = pool.acquire();
+                    slots_defer.push(slot);
+                    do_not_optimize(slot);
+                }
+            }
+
+            void manual_loop(slot_pool& pool, int n) {
+                std::uint32_t slots[1024];
+                for (int i = 0; i < n; ++i) {
+                    slots[i] = pool.acquire();
+                    do_not_optimize(slots[i]);
+                }
+                for (int i = n; i-- > 0;) {
+                    pool.release(slots[i]);
+                }
+            }
+
+        }
+
+        void run_bulk_benchmarks(runner& r) {
+            for (int const n : { 16, 64, 256, 1024 }) {
+                slot_pool pool(4096);
+                r.run("bulk", "per_slot_defer_stack", n, [&] { per_slot_defer(pool, n); });
+                r.run("bulk", "bulk_defer_64", n, [&] { bulk_slot_defer(pool, n); });
+                r.run("bulk", "manual_per_slot_loop", n, [&] { manual_loop(pool, n); });
+            }
+        }
+
+    }
+}
@@ -0,0 +1,115 @@
+#include <string>
+#include <hng/defer/defer.h>
+#include "bench.h"
+
+// N finally blocks around one try block: N nested HNG_DT_DEFER_FINALLY_PRESERVE constructs
+// against one HNG_DT_CHAIN of N finally blocks.
+//   happy:    nothing throws.
+//   throwing: the try block and every finally block throw; both constructs propagate the same preserved exception.
+// Nesting opens one try block (and one lambda frame) per finally block, the chain opens one for all of them.
+
+namespace hng {
+    namespace defer_bench {
+        namespace {
+
+            struct bench_exception {};
+
+            struct state {
+                long long work = 0;
+                long long cleanups = 0;
+                bool volatile fail = false;
+            };
+
+            HNG_DEFER_BENCH_NOINLINE void body(state& s) {
+                ++s.work;
+                if (s.fail)
+                    throw bench_exception{};
+            }
+
+            HNG_DEFER_BENCH_NOINLINE void cleanup(state& s) {
+                ++s.cleanups;
+                if (s.fail)
+                    throw bench_exception{};
+            }
+
+            struct nested_preserve {
+                static constexpr char const* name = "nested_preserve";
+                template<int Count>
+                static void run(state& s) {
+                    HNG_DT_DEFER_FINALLY_PRESERVE[&]
+                    {
+                        cleanup(s);
+                    }
+                    HNG_DT_TRY[&]
+                    {
+                        if constexpr (Count > 1) {
+                            run<Count - 1>(s);
+                        }
+                        else {
+                            body(s);
+                        }
+                    }
+                    HNG_DT_END;
+                }
+            };
+
+            struct chain {
+                static constexpr char const* name = "chain";
+                template<int Count>
+                static void run(state& s) {
+                    auto const finally = [&] { cleanup(s); };
+                    if constexpr (Count == 1) {
+                        HNG_DT_CHAIN finally HNG_DT_TRY[&] { body(s); } HNG_DT_END;
+                    }
+                    else if constexpr (Count == 2) {
+                        HNG_DT_CHAIN finally HNG_DT_AND finally HNG_DT_TRY[&] { body(s); } HNG_DT_END;
+                    }
+                    else if constexpr (Count == 4) {
+                        HNG_DT_CHAIN finally HNG_DT_AND finally HNG_DT_AND finally HNG_DT_AND finally
+                            HNG_DT_TRY[&] { body(s); } HNG_DT_END;
+                    }
+                    else {
+                        static_assert(Count == 8, "unsupported chain length");
+                        HNG_DT_CHAIN finally HNG_DT_AND finally HNG_DT_AND finally HNG_DT_AND finally
+                            HNG_DT_AND finally HNG_DT_AND finally HNG_DT_AND finally HNG_DT_AND finally
+                            HNG_DT_TRY[&] { body(s); } HNG_DT_END;
+                    }
+                }
+            };
+
+            template<class Construct, int Count>
+            void run_count(runner& r) {
+                state s;
+                r.run("chain", std::string(Construct::name) + "/happy", Count, [&] {
+                    Construct::template run<Count>(s);
+                });
+                s.fail = true;
+                r.run("chain", std::string(Construct::name) + "/throwing", Count, [&] {
+                    try {
+                        Construct::template run<Count>(s);
+                    }
+                    catch (hng::defer_exception const& ex) {
+                        do_not_optimize(ex);
+                    }
+                });
+                do_not_optimize(s.work);
+                do_not_optimize(s.cleanups);
+            }
+
+            template<class Construct>
+            void run_construct(runner& r) {
+                run_count<Construct, 1>(r);
+                run_count<Construct, 2>(r);
+                run_count<Construct, 4>(r);
+                run_count<Construct, 8>(r);
+            }
+
+        }
+
+        void run_chain_benchmarks(runner& r) {
+            run_construct<nested_preserve>(r);
+            run_construct<chain>(r);
+        }
+
+    }
+}
@@ -0,0 +1,75 @@
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <hng/defer/coalescing_scope.h>
+#include <hng/defer/defer_stack.h>
+#include "bench.h"
+
+// One event loop tick in which nested code requests "recompute index k" N times.
+//   repeated: the N requests go to 16 indices, so most of them are duplicates.
+//   unique:   every request is for a different index, so nothing can be coalesced (the table's overhead).
+// Each request is handled:
+//   immediate:        by recomputing the index at once.
+//   defer_stack:      by deferring the recomputation to the end of the tick, once per request.
+//   coalescing_scope: by hng::defer_once, so each index is recomputed once per tick.
+
+namespace hng {
+    namespace defer_bench {
+        namespace {
+
+            struct lookup_index {
+                std::array<std::uint32_t, 64> values{};
+                std::uint64_t checksum = 0;
+            };
+
+            constexpr int repeated_keys = 16;
+
+            HNG_DEFER_BENCH_NOINLINE void recompute(lookup_index& ix) noexcept {
+                std::uint64_t sum = 0;
+                for (std::uint32_t const v : ix.values) {
+                    sum = sum * 31 + v;
+                }
+                ix.checksum = sum;
+            }
+
+            // Stands for code deep in the call stack which requests the recomputation.
+            template<class Request>
+            HNG_DEFER_BENCH_NOINLINE void tick(lookup_index* indices, int requests, int keys, Request request) {
+                for (int i = 0; i < requests; ++i) {
+                    request(indices[i % keys]);
+                }
+            }
+
+            void run_workload(runner& r, char const* workload, int requests, int keys, lookup_index* indices) {
+                std::string const prefix = std::string(workload) + "/";
+                r.run("coalesce", prefix + "immediate", requests, [&] {
+                    tick(indices, requests, keys, [](lookup_index& ix) { recompute(ix); });
+                });
+                r.run("coalesce", prefix + "defer_stack", requests, [&] {
+                    hng::defer_stack deferred;
+                    tick(indices, requests, keys, [&deferred](lookup_index& ix) {
+                        deferred.push([&ix]() noexcept { recompute(ix); });
+                    });
+                });
+                r.run("coalesce", prefix + "coalescing_scope", requests, [&] {
+                    hng::coalescing_scope scope;
+                    tick(indices, requests, keys, [](lookup_index& ix) {
+                        hng::defer_once(&ix, [&ix]() noexcept { recompute(ix); });
+                    });
+                });
+                do_not_optimize(indices[0].checksum);
+            }
+
+        }
+
+        void run_coalesce_benchmarks(runner& r) {
+            for (int const requests : { 16, 64, 256, 1024 }) {
+                std::vector<lookup_index> indices(static_cast<std::size_t>(requests));
+                run_workload(r, "repeated", requests, repeated_keys < requests ? repeated_keys : requests, indices.data());
+                run_workload(r, "unique", requests, requests, indices.data());
+            }
+        }
+
+    }
+}
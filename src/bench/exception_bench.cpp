@@ -0,0 +1,86 @@
+#include <exception>
+#include <stdexcept>
+#include <hng/defer/defer.h>
+#include "bench.h"
+
+// Propagating the exceptions of several failing cleanups.
+//   nested_preserve:    N nested HNG_DT_DEFER_FINALLY_PRESERVE blocks, where the try block and every finally block throw;
+//                       each level rethrows the pending exception to nest it.
+//   nested_aggregate:   the same with HNG_DT_DEFER_FINALLY_AGGREGATE; each level keeps the pending exceptions as elements.
+//   collect_aggregate:  N failing cleanups run in a loop, collected into one hng::defer_aggregate_exception thrown once.
+
+namespace hng {
+    namespace defer_bench {
+        namespace {
+
+            HNG_DEFER_BENCH_NOINLINE void fail(int i) {
+                throw std::runtime_error(i == 0 ? "try" : "cleanup");
+            }
+
+            HNG_DEFER_BENCH_NOINLINE void nested_preserve(int depth) {
+                if (depth == 0) {
+                    fail(0);
+                }
+                HNG_DT_DEFER_FINALLY_PRESERVE[&]
+                {
+                    fail(depth);
+                }
+                    HNG_DT_TRY[&]
+                {
+                    nested_preserve(depth - 1);
+                }
+                HNG_DT_END;
+            }
+
+            HNG_DEFER_BENCH_NOINLINE void nested_aggregate(int depth) {
+                if (depth == 0) {
+                    fail(0);
+                }
+                HNG_DT_DEFER_FINALLY_AGGREGATE[&]
+                {
+                    fail(depth);
+                }
+                    HNG_DT_TRY[&]
+                {
+                    nested_aggregate(depth - 1);
+                }
+                HNG_DT_END;
+            }
+
+            HNG_DEFER_BENCH_NOINLINE void collect_aggregate(int count) {
+                hng::defer_aggregate_exception errors;
+                for (int i = 0; i <= count; ++i) {
+                    try {
+                        fail(i);
+                    }
+                    catch (...) {
+                        errors.add(std::current_exception());
+                    }
+                }
+                errors.throw_if_any();
+            }
+
+            template<class Op>
+            void run_throwing(runner& r, char const* name, int n, Op op) {
+                r.run("exception", name, n, [&] {
+                    try {
+                        op(n);
+                    }
+                    catch (std::exception const& ex) {
+                        do_not_optimize(ex);
+                    }
+                });
+            }
+
+        }
+
+        void run_exception_benchmarks(runner& r) {
+            for (int const n : { 1, 2, 4, 8, 16 }) {
+                run_throwing(r, "nested_preserve", n, nested_preserve);
+                run_throwing(r, "nested_aggregate", n, nested_aggregate);
+                run_throwing(r, "collect_aggregate", n, collect_aggregate);
+            }
+        }
+
+    }
+}
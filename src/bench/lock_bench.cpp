@@ -0,0 +1,169 @@
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <hng/defer/deferred_lock_guard.h>
+#include "bench.h"
+
+// A contended critical section on 1, 2, 4, ... threads: each operation publishes a new payload into a shared slot,
+// then frees the payload it replaced, formats a log line about it and notifies a condition variable.
+//   under_lock:          std::lock_guard, with the freeing, the formatting and the notification inside the critical section.
+//   deferred_lock_guard: hng::deferred_lock_guard, with those three deferred with after_unlock(), so only the swap is locked.
+//   deferred_lock_guard_spill: the same with a 32 byte inline buffer, so the deferred callables spill to a heap allocated chunk.
+// The throughput of all the threads, and the average time the mutex is held per operation, are recorded.
+
+namespace hng {
+    namespace defer_bench {
+        namespace {
+
+            constexpr int operations_per_thread = 20000;
+
+            // A small tree of allocations, so that freeing it takes a few calls to the allocator.
+            using payload = std::vector<std::string>;
+
+            // Accumulates the time for which the mutex is held; only the holder writes m_held_ns.
+            class hold_timed_mutex
+            {
+            private:
+                using clock = std::chrono::steady_clock;
+
+                std::mutex m_mutex;
+                clock::time_point m_locked_at;
+                std::uint64_t m_held_ns = 0;
+
+            public:
+                void lock() {
+                    m_mutex.lock();
+                    m_locked_at = clock::now();
+                }
+
+                void unlock() {
+                    m_held_ns += std::uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - m_locked_at).count());
+                    m_mutex.unlock();
+                }
+
+                std::uint64_t held_ns() const noexcept { return m_held_ns; }
+            };
+
+            struct shared_state {
+                hold_timed_mutex mutex;
+                std::condition_variable_any published;
+                std::unique_ptr<payload> slot;
+                std::uint64_t sequence = 0;
+            };
+
+            HNG_DEFER_BENCH_NOINLINE std::unique_ptr<payload> make_payload(std::uint64_t seed) {
+                auto p = std::make_unique<payload>();
+                p->reserve(8);
+                for (int i = 0; i < 8; ++i) {
+                    p->emplace_back(40, char('a' + (seed + std::uint64_t(i)) % 26));
+                }
+                return p;
+            }
+
+            HNG_DEFER_BENCH_NOINLINE void log_replaced(int thread, std::uint64_t sequence, std::size_t entries) noexcept {
+                char line[128];
+                int const n = std::snprintf(line, sizeof(line), "thread %d published #%llu, replacing %zu entries (%.3f)",
+                    thread, static_cast<unsigned long long>(sequence), entries, double(sequence) / 1000.0);
+                do_not_optimize(n);
+                do_not_optimize(line[0]);
+            }
+
+            void under_lock_operation(shared_state& s, int thread, std::unique_ptr<payload> next) {
+                std::lock_guard<hold_timed_mutex> const guard(s.mutex);
+                std::unique_ptr<payload> replaced = std::move(s.slot);
+                s.slot = std::move(next);
+                std::uint64_t const sequence = ++s.sequence;
+                log_replaced(thread, sequence, replaced ? replaced->size() : 0);
+                replaced.reset();
+                s.published.notify_one();
+            }
+
+            template<std::size_t InlineBytes>
+            void deferred_operation(shared_state& s, int thread, std::unique_ptr<payload> next) {
+                hng::deferred_lock_guard<hold_timed_mutex, InlineBytes> guard(s.mutex);
+                std::unique_ptr<payload> replaced = std::move(s.slot);
+                s.slot = std::move(next);
+                std::uint64_t const sequence = ++s.sequence;
+                std::size_t const entries = replaced ? replaced->size() : 0;
+                // Run in reverse order after the unlock: log, notify, free.
+                guard.after_unlock([replaced = std::move(replaced)]() noexcept {});
+                guard.after_unlock([&s]() noexcept { s.published.notify_one(); });
+                guard.after_unlock([thread, sequence, entries]() noexcept { log_replaced(thread, sequence, entries); });
+            }
+
+            // Runs `threads` threads of operations_per_thread operations each. Returns the wall-clock time, in ns,
+            // and adds the time for which the mutex was held to `held_ns`.
+            template<class Operation>
+            double run_threads(int threads, Operation operation, std::uint64_t& held_ns) {
+                shared_state s;
+                std::atomic<bool> go{ false };
+                std::vector<std::thread> workers;
+                workers.reserve(static_cast<std::size_t>(threads));
+                for (int t = 0; t < threads; ++t) {
+                    workers.emplace_back([&, t] {
+                        while (!go.load(std::memory_order_acquire)) {
+                            std::this_thread::yield();
+                        }
+                        for (int i = 0; i < operations_per_thread; ++i) {
+                            operation(s, t, make_payload(std::uint64_t(i)));
+                        }
+                    });
+                }
+                using clock = std::chrono::steady_clock;
+                auto const start = clock::now();
+                go.store(true, std::memory_order_release);
+                for (std::thread& worker : workers) {
+                    worker.join();
+                }
+                double const ns = std::chrono::duration<double, std::nano>(clock::now() - start).count();
+                held_ns = s.mutex.held_ns();
+                return ns;
+            }
+
+            template<class Operation>
+            void run_variant(runner& r, char const* name, int threads, Operation operation) {
+                if (!r.enabled("lock", name))
+                    return;
+                double best_ns = 0;
+                std::uint64_t best_held_ns = 0;
+                for (int rep = 0; rep < r.repetitions(); ++rep) {
+                    std::uint64_t held_ns = 0;
+                    double const ns = run_threads(threads, operation, held_ns);
+                    if (rep == 0 || ns < best_ns) {
+                        best_ns = ns;
+                        best_held_ns = held_ns;
+                    }
+                }
+                double const operations = double(threads) * operations_per_thread;
+                r.add(result{ "lock", name, threads, {
+                    { "ops_per_s", operations / best_ns * 1e9 },
+                    { "hold_ns_per_op", double(best_held_ns) / operations },
+                    { "threads", double(threads) } } });
+            }
+
+        }
+
+        void run_lock_benchmarks(runner& r) {
+            for (int const threads : { 1, 2, 4, 8, 16 }) {
+                run_variant(r, "under_lock", threads, [](shared_state& s, int thread, std::unique_ptr<payload> next) {
+                    under_lock_operation(s, thread, std::move(next));
+                });
+                run_variant(r, "deferred_lock_guard", threads, [](shared_state& s, int thread, std::unique_ptr<payload> next) {
+                    deferred_operation<256>(s, thread, std::move(next));
+                });
+                run_variant(r, "deferred_lock_guard_spill", threads, [](shared_state& s, int thread, std::unique_ptr<payload> next) {
+                    deferred_operation<32>(s, thread, std::move(next));
+                });
+            }
+        }
+
+    }
+}
@@ -0,0 +1,124 @@
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include "bench.h"
+
+namespace hng {
+    namespace defer_bench {
+
+        void runner::add(result r) {
+            std::cerr << std::left << std::setw(64) << (r.suite + "/" + r.name + "/" + std::to_string(r.param));
+            for (auto const& metric : r.metrics) {
+                std::cerr << ' ' << metric.first << '=' << metric.second;
+            }
+            std::cerr << std::endl;
+            m_results.push_back(std::move(r));
+        }
+
+        namespace {
+            void write_json_string(std::ostream& os, std::string const& s) {
+                os << '"';
+                for (char const c : s) {
+                    if (c == '"' || c == '\\')
+                        os << '\\';
+                    os << c;
+                }
+                os << '"';
+            }
+
+            char const* compiler_name() {
+#if defined(__clang__)
+                return "clang " __clang_version__;
+#elif defined(__GNUC__)
+                return "gcc " __VERSION__;
+#elif defined(_MSC_VER)
+                return "msvc";
+#else
+                return "unknown";
+#endif
+            }
+        }
+
+        void runner::write_json(std::ostream& os) const {
+            os << "{\n  \"compiler\": ";
+            write_json_string(os, compiler_name());
+            os << ",\n  \"optimization\": ";
+            write_json_string(os, HNG_DEFER_BENCH_OPT);
+            os << ",\n  \"cplusplus\": " << __cplusplus << ",\n  \"results\": [";
+            os << std::setprecision(12);
+            bool first = true;
+            for (auto const& r : m_results) {
+                os << (first ? "\n    {" : ",\n    {");
+                first = false;
+                os << "\"suite\": ";
+                write_json_string(os, r.suite);
+                os << ", \"name\": ";
+                write_json_string(os, r.name);
+                os << ", \"param\": " << r.param;
+                for (auto const& metric : r.metrics) {
+                    os << ", ";
+                    write_json_string(os, metric.first);
+                    os << ": " << metric.second;
+                }
+                os << '}';
+            }
+            os << "\n  ]\n}\n";
+        }
+
+    }
+}
+
+int main(int argc, char** argv) {
+    char const* out_path = nullptr;
+    std::string filter;
+    long long min_time_ms = 100;
+    int repetitions = 5;
+    for (int i = 1; i < argc; ++i) {
+        if (0 == std::strcmp(argv[i], "--out") && i + 1 < argc) {
+            out_path = argv[++i];
+        }
+        else if (0 == std::strcmp(argv[i], "--filter") && i + 1 < argc) {
+            filter = argv[++i];
+        }
+        else if (0 == std::strcmp(argv[i], "--min-time-ms") && i + 1 < argc) {
+            min_time_ms = std::atoll(argv[++i]);
+        }
+        else if (0 == std::strcmp(argv[i], "--repetitions") && i + 1 < argc) {
+            repetitions = std::atoi(argv[++i]);
+        }
+        else {
+            std::cerr << "Usage: " << argv[0] << " [--out results.json] [--filter suite/name] [--min-time-ms 100] [--repetitions 5]" << std::endl;
+            return 2;
+        }
+    }
+
+    hng::defer_bench::runner r(filter, std::chrono::milliseconds(min_time_ms), repetitions < 1 ? 1 : repetitions);
+    hng::defer_bench::run_scope_benchmarks(r);
+    hng::defer_bench::run_bulk_benchmarks(r);
+    hng::defer_bench::run_reclaimer_benchmarks(r);
+    hng::defer_bench::run_async_benchmarks(r);
+    hng::defer_bench::run_thread_exit_benchmarks(r);
+    hng::defer_bench::run_exception_benchmarks(r);
+    hng::defer_bench::run_parallel_benchmarks(r);
+    hng::defer_bench::run_arena_benchmarks(r);
+    hng::defer_bench::run_chain_benchmarks(r);
+    hng::defer_bench::run_shutdown_benchmarks(r);
+    hng::defer_bench::run_coalesce_benchmarks(r);
+    hng::defer_bench::run_lock_benchmarks(r);
+
+    if (out_path) {
+        std::ofstream out(out_path);
+        r.write_json(out);
+        if (!out) {
+            std::cerr << "Failed to write " << out_path << std::endl;
+            return 1;
+        }
+    }
+    else {
+        r.write_json(std::cout);
+    }
+    return 0;
+}
@@ -0,0 +1,134 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+#include <hng/defer/defer_core.h>
+#include <hng/defer/parallel_defer.h>
+#include "bench.h"
+
+// Teardown of a scope which owns 256 independent resources, each released by its own cleanup:
+// run one after another (nested hng::defer), against run concurrently by hng::parallel_defer_group
+// on pools of 1, 2, 4, ... workers.
+//   io:  each cleanup blocks for 200 us (closing a socket, fsync), so workers help beyond the core count.
+//   cpu: each cleanup spins for 20 us (freeing a large structure), so workers only help up to the core count.
+// The wall-clock time of the whole teardown is recorded.
+// many: N = 1024 ... 131072 trivial cleanups on a pool with a worker per core, so that the cost of adding
+//   and dispatching the cleanups dominates (a teardown of thousands of files); the time per cleanup should stay flat.
+
+namespace hng {
+    namespace defer_bench {
+        namespace {
+
+            constexpr int cleanup_count = 256;
+            constexpr auto io_duration = std::chrono::microseconds(200);
+            constexpr auto cpu_duration = std::chrono::microseconds(20);
+
+            std::uint64_t volatile sink = 0;
+
+            HNG_DEFER_BENCH_NOINLINE void io_cleanup() {
+                std::this_thread::sleep_for(io_duration);
+            }
+
+            HNG_DEFER_BENCH_NOINLINE void cpu_cleanup() {
+                using clock = std::chrono::steady_clock;
+                auto const stop = clock::now() + cpu_duration;
+                std::uint64_t value = 0;
+                while (clock::now() < stop) {
+                    value = value * 6364136223846793005u + 1442695040888963407u;
+                }
+                sink = sink + value;
+            }
+
+            // Nests `remaining` hng::defer scopes, so that the cleanups run one after another in reverse order.
+            template<class Cleanup>
+            HNG_DEFER_BENCH_NOINLINE void serial_scope(Cleanup cleanup, int remaining) {
+                if (remaining == 0)
+                    return;
+                auto const callable = [cleanup]() noexcept { cleanup(); };
+                hng::defer<decltype(callable)> const cleanup_defer(callable);
+                serial_scope(cleanup, remaining - 1);
+            }
+
+            template<class Cleanup>
+            HNG_DEFER_BENCH_NOINLINE void parallel_scope(hng::parallel_defer_pool& pool, Cleanup cleanup) {
+                hng::parallel_defer_group teardown(pool);
+                for (int i = 0; i < cleanup_count; ++i) {
+                    teardown.add(cleanup);
+                }
+            }
+
+            template<class Scope>
+            double best_ms(runner& r, Scope&& scope) {
+                using clock = std::chrono::steady_clock;
+                double best = 0;
+                for (int rep = 0; rep < r.repetitions(); ++rep) {
+                    auto const start = clock::now();
+                    scope();
+                    double const ms = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+                    if (rep == 0 || ms < best)
+                        best = ms;
+                }
+                return best;
+            }
+
+            template<class Cleanup>
+            void run_workload(runner& r, char const* workload, Cleanup cleanup, std::vector<std::size_t> const& pool_sizes) {
+                std::string const serial_name = std::string(workload) + "/serial_defer";
+                double serial_ms = 0;
+                if (r.enabled("parallel", serial_name)) {
+                    serial_ms = best_ms(r, [&] { serial_scope(cleanup, cleanup_count); });
+                    r.add(result{ "parallel", serial_name, cleanup_count, { { "ms", serial_ms }, { "threads", 1 } } });
+                }
+                std::string const parallel_name = std::string(workload) + "/parallel_defer_group";
+                if (!r.enabled("parallel", parallel_name))
+                    return;
+                for (std::size_t const threads : pool_sizes) {
+                    hng::parallel_defer_pool pool(threads);
+                    double const ms = best_ms(r, [&] { parallel_scope(pool, cleanup); });
+                    result measured{ "parallel", parallel_name, cleanup_count, { { "ms", ms }, { "threads", double(threads) } } };
+                    if (serial_ms > 0) {
+                        measured.metrics.emplace_back("speedup", serial_ms / ms);
+                    }
+                    r.add(std::move(measured));
+                }
+            }
+
+            void run_many(runner& r, std::size_t threads) {
+                if (!r.enabled("parallel", "many/parallel_defer_group"))
+                    return;
+                hng::parallel_defer_pool pool(threads);
+                for (int const count : { 1024, 16384, 131072 }) {
+                    std::atomic<std::uint64_t> released{ 0 };
+                    double const ms = best_ms(r, [&] {
+                        hng::parallel_defer_group teardown(pool);
+                        for (int i = 0; i < count; ++i) {
+                            teardown.add([&released] { released.fetch_add(1, std::memory_order_relaxed); });
+                        }
+                    });
+                    do_not_optimize(released);
+                    r.add(result{ "parallel", "many/parallel_defer_group", count, {
+                        { "ms", ms },
+                        { "ns_per_cleanup", ms * 1e6 / count },
+                        { "threads", double(threads) } } });
+                }
+            }
+
+        }
+
+        void run_parallel_benchmarks(runner& r) {
+            std::size_t const cores = std::max<std::size_t>(1, std::thread::hardware_concurrency());
+            std::vector<std::size_t> pool_sizes;
+            for (std::size_t threads = 1; threads <= std::max<std::size_t>(16, cores); threads *= 2) {
+                pool_sizes.push_back(threads);
+            }
+            run_workload(r, "io", [] { io_cleanup(); }, pool_sizes);
+            run_workload(r, "cpu", [] { cpu_cleanup(); }, pool_sizes);
+            run_many(r, cores);
+        }
+
+    }
+}
@@ -0,0 +1,141 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <hng/defer/deferred_reclaimer.h>
+#include "bench.h"
+
+// Throughput of a shared pointer which readers load and writers replace,
+// with 1 to all hardware threads: hng::deferred_reclaimer against a mutex held around each access.
+// One in `update_every` operations replaces the pointer and retires the old node.
+
+namespace hng {
+    namespace defer_bench {
+        namespace {
+
+            struct node {
+                std::uint64_t value;
+            };
+
+            struct reclaimer_shared {
+                hng::deferred_reclaimer reclaimer;
+                std::atomic<node*> head{ new node{ 0 } };
+
+                ~reclaimer_shared() { delete head.load(); }
+
+                void read(std::uint64_t& sum) {
+                    auto const guard = reclaimer.pin();
+                    sum += head.load(std::memory_order_acquire)->value;
+                }
+
+                void update(std::uint64_t value) {
+                    reclaimer.retire(head.exchange(new node{ value }, std::memory_order_acq_rel));
+                }
+
+                void finish_thread() { reclaimer.collect(); }
+            };
+
+            struct mutex_shared {
+                std::mutex mutex;
+                node* head = new node{ 0 };
+
+                ~mutex_shared() { delete head; }
+
+                void read(std::uint64_t& sum) {
+                    std::lock_guard<std::mutex> const lock(mutex);
+                    sum += head->value;
+                }
+
+                void update(std::uint64_t value) {
+                    node* const replacement = new node{ value };
+                    node* old;
+                    {
+                        std::lock_guard<std::mutex> const lock(mutex);
+                        old = head;
+                        head = replacement;
+                    }
+                    delete old;
+                }
+
+                void finish_thread() {}
+            };
+
+            // Runs `threads` threads for about min_time, and returns the total operations per second.
+            template<class Shared>
+            double measure(runner& r, int threads, int update_every) {
+                Shared shared;
+                std::atomic<bool> start{ false };
+                std::atomic<bool> stop{ false };
+                std::atomic<std::uint64_t> total{ 0 };
+                std::vector<std::thread> workers;
+                for (int t = 0; t < threads; ++t) {
+                    workers.emplace_back([&, t] {
+                        while (!start.load(std::memory_order_acquire)) {
+                            std::this_thread::yield();
+                        }
+                        std::uint64_t ops = 0;
+                        std::uint64_t sum = 0;
+                        while (!stop.load(std::memory_order_relaxed)) {
+                            for (int i = 0; i < 64; ++i) {
+                                if ((ops + std::uint64_t(t)) % std::uint64_t(update_every) == 0) {
+                                    shared.update(ops);
+                                }
+                                else {
+                                    shared.read(sum);
+                                }
+                                ++ops;
+                            }
+                        }
+                        shared.finish_thread();
+                        do_not_optimize(sum);
+                        total += ops;
+                    });
+                }
+                using clock = std::chrono::steady_clock;
+                auto const begin = clock::now();
+                start.store(true, std::memory_order_release);
+                std::this_thread::sleep_for(r.min_time());
+                stop.store(true, std::memory_order_relaxed);
+                for (auto& worker : workers) {
+                    worker.join();
+                }
+                double const seconds = std::chrono::duration<double>(clock::now() - begin).count();
+                return double(total.load()) / seconds;
+            }
+
+            template<class Shared>
+            void run_threads(runner& r, char const* name, int threads, int update_every) {
+                if (!r.enabled("reclaimer", name))
+                    return;
+                double best = 0;
+                for (int rep = 0; rep < r.repetitions(); ++rep) {
+                    best = std::max(best, measure<Shared>(r, threads, update_every));
+                }
+                r.add(result{ "reclaimer", name, threads, {
+                    { "ops_per_sec", best },
+                    { "ns_per_op_per_thread", 1e9 * double(threads) / best },
+                    { "update_every", double(update_every) } } });
+            }
+
+        }
+
+        void run_reclaimer_benchmarks(runner& r) {
+            int const max_threads = std::max(1, int(std::thread::hardware_concurrency()));
+            std::vector<int> counts;
+            for (int threads = 1; threads < max_threads; threads *= 2) {
+                counts.push_back(threads);
+            }
+            counts.push_back(max_threads);
+            for (int const threads : counts) {
+                run_threads<reclaimer_shared>(r, "deferred_reclaimer/read_mostly", threads, 16);
+                run_threads<mutex_shared>(r, "mutex/read_mostly", threads, 16);
+                run_threads<reclaimer_shared>(r, "deferred_reclaimer/update_heavy", threads, 2);
+                run_threads<mutex_shared>(r, "mutex/update_heavy", threads, 2);
+            }
+        }
+
+    }
+}
@@ -0,0 +1,233 @@
+
+#include <hng/defer/defer.h>
+#include <hng/defer/unique_defer.h>
+#include "bench.h"
+
+// Compares every scope-exit construct against hand-written cleanup,
+// on the happy path and on the throwing path, at nesting depths 1 to 32.
+
+namespace hng {
+    namespace defer_bench {
+        namespace {
+
+            struct bench_exception {};
+
+            struct state {
+                long long work = 0;
+                long long cleanups = 0;
+                bool volatile fail = false;
+            };
+
+            inline void body(state& s) {
+                ++s.work;
+                if (s.fail)
+                    throw bench_exception{};
+            }
+
+            inline void cleanup(state& s) noexcept {
+                ++s.cleanups;
+            }
+
+            // Each construct nests `Depth` scopes, each with its own cleanup, around one body.
+
+            struct no_cleanup {
+                static constexpr char const* name = "none";
+                template<int Depth>
+                static void run(state& s) {
+                    if constexpr (Depth > 1) {
+                        run<Depth - 1>(s);
+                    }
+                    else {
+                        body(s);
+                    }
+                }
+            };
+
+            struct plain_destructor {
+                static constexpr char const* name = "plain_destructor";
+                struct guard {
+                    state& s;
+                    ~guard() { cleanup(s); }
+                };
+                template<int Depth>
+                static void run(state& s) {
+                    guard const g{ s };
+                    if constexpr (Depth > 1) {
+                        run<Depth - 1>(s);
+                    }
+                    else {
+                        body(s);
+                    }
+                }
+            };
+
+            struct manual_try_catch {
+                static constexpr char const* name = "manual_try_catch";
+                template<int Depth>
+                static void run(state& s) {
+                    try {
+                        if constexpr (Depth > 1) {
+                            run<Depth - 1>(s);
+                        }
+                        else {
+                            body(s);
+                        }
+                    }
+                    catch (...) {
+                        cleanup(s);
+                        throw;
+                    }
+                    cleanup(s);
+                }
+            };
+
+            struct defer_class {
+                static constexpr char const* name = "hng::defer";
+                template<int Depth>
+                static void run(state& s) {
+                    auto const my_callable = [&s]()noexcept { cleanup(s); };
+                    hng::defer<decltype(my_callable)> const my_defer(my_callable);
+                    if constexpr (Depth > 1) {
+                        run<Depth - 1>(s);
+                    }
+                    else {
+                        body(s);
+                    }
+                }
+            };
+
+            struct unique_defer_class {
+                static constexpr char const* name = "hng::unique_defer";
+                template<int Depth>
+                static void run(state& s) {
+                    hng::unique_defer const my_defer([&s]()noexcept { cleanup(s); });
+                    if constexpr (Depth > 1) {
+                        run<Depth - 1>(s);
+                    }
+                    else {
+                        body(s);
+                    }
+                }
+            };
+
+            struct defer_block {
+                static constexpr char const* name = "HNG_DEFER_BLOCK";
+                template<int Depth>
+                static void run(state& s) {
+                    HNG_DEFER_BLOCK({ cleanup(s); });
+                    if constexpr (Depth > 1) {
+                        run<Depth - 1>(s);
+                    }
+                    else {
+                        body(s);
+                    }
+                }
+            };
+
+            struct defer_begin_end {
+                static constexpr char const* name = "HNG_DEFER_BEGIN/END";
+                template<int Depth>
+                static void run(state& s) {
+                    HNG_DEFER_BEGIN
+                    {
+                        cleanup(s);
+                    }
+                    HNG_DEFER_END;
+                    if constexpr (Depth > 1) {
+                        run<Depth - 1>(s);
+                    }
+                    else {
+                        body(s);
+                    }
+                }
+            };
+
+            struct dt_defer_finally {
+                static constexpr char const* name = "HNG_DT_DEFER_FINALLY";
+                template<int Depth>
+                static void run(state& s) {
+                    HNG_DT_DEFER_FINALLY[&]
+                    {
+                        cleanup(s);
+                    }
+                    HNG_DT_TRY[&]
+                    {
+                        if constexpr (Depth > 1) {
+                            run<Depth - 1>(s);
+                        }
+                        else {
+                            body(s);
+                        }
+                    }
+                    HNG_DT_END;
+                }
+            };
+
+            struct dt_defer_finally_preserve {
+                static constexpr char const* name = "HNG_DT_DEFER_FINALLY_PRESERVE";
+                template<int Depth>
+                static void run(state& s) {
+                    HNG_DT_DEFER_FINALLY_PRESERVE[&]
+                    {
+                        cleanup(s);
+                    }
+                    HNG_DT_TRY[&]
+                    {
+                        if constexpr (Depth > 1) {
+                            run<Depth - 1>(s);
+                        }
+                        else {
+                            body(s);
+                        }
+                    }
+                    HNG_DT_END;
+                }
+            };
+
+            template<class Construct, int Depth>
+            void run_depth(runner& r) {
+                state s;
+                r.run("scope", std::string(Construct::name) + "/happy", Depth, [&] {
+                    Construct::template run<Depth>(s);
+                });
+                do_not_optimize(s.work);
+                do_not_optimize(s.cleanups);
+
+                s.fail = true;
+                r.run("scope", std::string(Construct::name) + "/throwing", Depth, [&] {
+                    try {
+                        Construct::template run<Depth>(s);
+                    }
+                    catch (bench_exception const&) {
+                    }
+                });
+                do_not_optimize(s.work);
+                do_not_optimize(s.cleanups);
+            }
+
+            template<class Construct>
+            void run_construct(runner& r) {
+                run_depth<Construct, 1>(r);
+                run_depth<Construct, 2>(r);
+                run_depth<Construct, 4>(r);
+                run_depth<Construct, 8>(r);
+                run_depth<Construct, 16>(r);
+                run_depth<Construct, 32>(r);
+            }
+
+        }
+
+        void run_scope_benchmarks(runner& r) {
+            run_construct<no_cleanup>(r);
+            run_construct<plain_destructor>(r);
+            run_construct<manual_try_catch>(r);
+            run_construct<defer_class>(r);
+            run_construct<unique_defer_class>(r);
+            run_construct<defer_block>(r);
+            run_construct<defer_begin_end>(r);
+            run_construct<dt_defer_finally>(r);
+            run_construct<dt_defer_finally_preserve>(r);
+        }
+
+    }
+}
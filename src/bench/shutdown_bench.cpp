@@ -0,0 +1,122 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <string>
+#include <hng/defer/shutdown_defer.h>
+#include <hng/defer/unique_resource.h>
+#include "bench.h"
+
+#if DETAIL_HNG_UNIQUE_RESOURCE_HAS_POSIX
+#include <sys/wait.h>
+#endif
+
+// Shutdown of a process with a large heap: a forked child builds a std::map of N MiB of small strings,
+// registers a skippable cleanup which frees it and an essential cleanup which writes to a pipe (the "journal flush"),
+// and then exits:
+//   full_exit: std::exit, which runs every cleanup and the destructors of the static objects.
+//   fast_exit: hng::fast_exit, which only runs the essential cleanup before std::_Exit.
+// The time from the exit request to the end of the child (waitpid) is recorded, including the OS tearing down the process.
+
+namespace hng {
+    namespace defer_bench {
+        namespace {
+
+#if DETAIL_HNG_UNIQUE_RESOURCE_HAS_POSIX
+
+            using heap = std::map<std::uint64_t, std::string>;
+
+            // Builds the heap in a child, waits for the go byte, then exits. Returns the time the child took to exit, in ms,
+            // or a negative value if the child could not be run.
+            double measure_shutdown(bool fast, int mebibytes) {
+                int ready_fds[2];
+                int go_fds[2];
+                if (::pipe(ready_fds) != 0)
+                    return -1;
+                hng::unique_fd const ready_read(ready_fds[0]);
+                hng::unique_fd ready_write(ready_fds[1]);
+                if (::pipe(go_fds) != 0)
+                    return -1;
+                hng::unique_fd go_read(go_fds[0]);
+                hng::unique_fd const go_write(go_fds[1]);
+                // The child exits through std::exit, which would write buffered output a second time.
+                std::cout.flush();
+                std::fflush(nullptr);
+                pid_t const pid = ::fork();
+                if (pid < 0)
+                    return -1;
+                if (pid == 0) {
+                    int const journal = ready_write.release();
+                    // One entry takes about 64 bytes: the map node and the string's heap buffer.
+                    std::uint64_t const entries = std::uint64_t(mebibytes) * 1024 * 1024 / 64;
+                    heap* const h = new heap();
+                    for (std::uint64_t i = 0; i < entries; ++i) {
+                        h->emplace_hint(h->end(), i, std::string(24, char('a' + i % 26)));
+                    }
+                    hng::shutdown_defer([h]() noexcept { delete h; }, hng::shutdown_cleanup::skippable);
+                    hng::shutdown_defer([journal]() noexcept {
+                        char const flushed = 'f';
+                        ssize_t const written = ::write(journal, &flushed, 1);
+                        static_cast<void>(written);
+                    }, hng::shutdown_cleanup::essential);
+                    char const ready = 'r';
+                    char go = 0;
+                    if (::write(journal, &ready, 1) != 1 || ::read(go_read.get(), &go, 1) != 1)
+                        std::_Exit(1);
+                    if (fast)
+                        hng::fast_exit(0);
+                    std::exit(0);
+                }
+                ready_write.reset();
+                go_read.reset();
+                char byte = 0;
+                int status = 0;
+                if (::read(ready_read.get(), &byte, 1) != 1) {
+                    ::waitpid(pid, &status, 0);
+                    return -1;
+                }
+                using clock = std::chrono::steady_clock;
+                auto const start = clock::now();
+                char const go = 'g';
+                bool const sent = ::write(go_write.get(), &go, 1) == 1;
+                bool const flushed = sent && ::read(ready_read.get(), &byte, 1) == 1 && byte == 'f';
+                ::waitpid(pid, &status, 0);
+                double const ms = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+                if (!flushed || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+                    return -1;
+                return ms;
+            }
+
+            void run_mode(runner& r, char const* name, bool fast, int mebibytes) {
+                if (!r.enabled("shutdown", name))
+                    return;
+                double best = -1;
+                for (int rep = 0; rep < r.repetitions(); ++rep) {
+                    double const ms = measure_shutdown(fast, mebibytes);
+                    if (ms >= 0 && (best < 0 || ms < best))
+                        best = ms;
+                }
+                if (best >= 0) {
+                    r.add(result{ "shutdown", name, mebibytes, { { "ms", best } } });
+                }
+            }
+
+#endif // ^^^ DETAIL_HNG_UNIQUE_RESOURCE_HAS_POSIX
+
+        }
+
+        void run_shutdown_benchmarks(runner& r) {
+#if DETAIL_HNG_UNIQUE_RESOURCE_HAS_POSIX
+            for (int const mebibytes : { 16, 64, 256 }) {
+                run_mode(r, "full_exit", false, mebibytes);
+                run_mode(r, "fast_exit", true, mebibytes);
+            }
+#else
+            static_cast<void>(r);
+#endif // ^^^ DETAIL_HNG_UNIQUE_RESOURCE_HAS_POSIX
+        }
+
+    }
+}
@@ -0,0 +1,101 @@
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <vector>
+#include <hng/defer/defer_at_thread_exit.h>
+#include "bench.h"
+
+// Thread-exit cleanup: hng::defer_at_thread_exit against the thread_local patterns it replaces.
+//   register: cost of registering N cleanups in a fresh thread,
+//             against a thread_local vector of std::function run by a thread_local guard.
+//   access:   cost of touching a per-thread cache on the hot path,
+//             thread_local with a destructor (guarded access) against a trivial thread_local
+//             whose cleanup is registered once with hng::defer_at_thread_exit.
+
+namespace hng {
+    namespace defer_bench {
+        namespace {
+
+            std::uint64_t volatile sink = 0;
+
+            struct function_list_guard {
+                std::vector<std::function<void()>> callables;
+                ~function_list_guard() {
+                    for (auto it = callables.rbegin(); it != callables.rend(); ++it) {
+                        (*it)();
+                    }
+                }
+            };
+
+            HNG_DEFER_BENCH_NOINLINE void register_hng(std::uint64_t value) {
+                hng::defer_at_thread_exit([value]() noexcept { sink = sink + value; });
+            }
+
+            HNG_DEFER_BENCH_NOINLINE void register_thread_local_vector(std::uint64_t value) {
+                static thread_local function_list_guard guard;
+                guard.callables.emplace_back([value] { sink = sink + value; });
+            }
+
+            template<class Register>
+            void run_register(runner& r, char const* name, int registrations, Register reg) {
+                if (!r.enabled("thread_exit", name))
+                    return;
+                using clock = std::chrono::steady_clock;
+                constexpr int threads = 256;
+                double best = 0;
+                for (int rep = 0; rep < r.repetitions(); ++rep) {
+                    double total_ns = 0;
+                    for (int t = 0; t < threads; ++t) {
+                        std::thread([&] {
+                            auto const start = clock::now();
+                            for (int i = 0; i < registrations; ++i) {
+                                reg(std::uint64_t(i));
+                            }
+                            total_ns += std::chrono::duration<double, std::nano>(clock::now() - start).count();
+                        }).join();
+                    }
+                    double const ns = total_ns / double(threads * registrations);
+                    if (rep == 0 || ns < best)
+                        best = ns;
+                }
+                r.add(result{ "thread_exit", name, registrations, { { "ns_per_registration", best }, { "threads", double(threads) } } });
+            }
+
+            struct guarded_cache {
+                std::uint64_t hits = 0;
+                ~guarded_cache() { sink = sink + hits; }
+            };
+
+            struct trivial_cache {
+                std::uint64_t hits;
+                bool registered;
+            };
+
+            HNG_DEFER_BENCH_NOINLINE void touch_guarded() {
+                static thread_local guarded_cache cache;
+                ++cache.hits;
+            }
+
+            HNG_DEFER_BENCH_NOINLINE void touch_trivial() {
+                static thread_local trivial_cache cache;
+                if (!cache.registered) {
+                    cache.registered = true;
+                    hng::defer_at_thread_exit([]() noexcept { sink = sink + cache.hits; });
+                }
+                ++cache.hits;
+            }
+
+        }
+
+        void run_thread_exit_benchmarks(runner& r) {
+            for (int const registrations : { 1, 8, 64 }) {
+                run_register(r, "register/hng::defer_at_thread_exit", registrations, register_hng);
+                run_register(r, "register/thread_local_vector_guard", registrations, register_thread_local_vector);
+            }
+            r.run("thread_exit", "access/thread_local_with_destructor", 1, [] { touch_guarded(); });
+            r.run("thread_exit", "access/trivial_thread_local+defer_at_thread_exit", 1, [] { touch_trivial(); });
+        }
+
+    }
+}
@@ -0,0 +1,29 @@
+# Compiles SOURCE to assembly and fails if the assembly contains a landing pad
+# or exception handling table.
+#
+# Usage:
+#   cmake -DCOMPILER=<c++ compiler> -DSOURCE=<file.cpp> -DINCLUDE_DIR=<dir>
+#         -DFLAGS="<space separated flags>" -DOUTPUT=<file.s>
+#         -P check_no_landing_pad.cmake
+
+separate_arguments(flag_list UNIX_COMMAND "${FLAGS}")
+get_filename_component(output_dir "${OUTPUT}" DIRECTORY)
+file(MAKE_DIRECTORY "${output_dir}")
+
+execute_process(
+  COMMAND "${COMPILER}" ${flag_list} "-I${INCLUDE_DIR}" -S -o "${OUTPUT}" "${SOURCE}"
+  RESULT_VARIABLE result
+  ERROR_VARIABLE errors
+)
+if(NOT result EQUAL 0)
+  message(FATAL_ERROR "Failed to compile ${SOURCE}:\n${errors}")
+endif()
+
+file(READ "${OUTPUT}" assembly)
+foreach(pattern __cxa_begin_catch __cxa_rethrow _Unwind_Resume gcc_except_table __gxx_personality)
+  string(FIND "${assembly}" "${pattern}" position)
+  if(NOT position EQUAL -1)
+    message(FATAL_ERROR "${OUTPUT} contains `${pattern}`; expected no landing pad")
+  endif()
+endforeach()
+message(STATUS "${OUTPUT}: no landing pad")
@@ -0,0 +1,127 @@
+# Compiles SOURCE to assembly with one section per function, and compares every
+# `<case>__defer` function against its `<case>__manual` twin on:
+#   - instruction count (hot and cold parts),
+#   - stack frame size (the largest .cfi_def_cfa_offset),
+#   - EH table size (bytes emitted in the function's .gcc_except_table section).
+# Fails if a __defer function exceeds its twin by more than the allowed slack.
+# A __defer function which is cheaper than its twin is fine.
+#
+# Usage:
+#   cmake -DCOMPILER=<c++ compiler> -DSOURCE=<file.cpp> -DINCLUDE_DIR=<dir>
+#         -DFLAGS="<space separated flags>" -DOUTPUT=<file.s>
+#         [-DMAX_EXTRA_INSTRUCTIONS=<n>] [-DMAX_EXTRA_FRAME_BYTES=<n>] [-DMAX_EXTRA_EH_BYTES=<n>]
+#         -P compare_overhead.cmake
+
+cmake_policy(SET CMP0057 NEW) # if(IN_LIST)
+
+if(NOT DEFINED MAX_EXTRA_INSTRUCTIONS)
+  set(MAX_EXTRA_INSTRUCTIONS 0)
+endif()
+if(NOT DEFINED MAX_EXTRA_FRAME_BYTES)
+  set(MAX_EXTRA_FRAME_BYTES 0)
+endif()
+if(NOT DEFINED MAX_EXTRA_EH_BYTES)
+  set(MAX_EXTRA_EH_BYTES 0)
+endif()
+
+separate_arguments(flag_list UNIX_COMMAND "${FLAGS}")
+get_filename_component(output_dir "${OUTPUT}" DIRECTORY)
+file(MAKE_DIRECTORY "${output_dir}")
+
+execute_process(
+  COMMAND "${COMPILER}" ${flag_list} -ffunction-sections "-I${INCLUDE_DIR}" -S -o "${OUTPUT}" "${SOURCE}"
+  RESULT_VARIABLE result
+  ERROR_VARIABLE errors
+)
+if(NOT result EQUAL 0)
+  message(FATAL_ERROR "Failed to compile ${SOURCE}:\n${errors}")
+endif()
+
+# The metrics of function <f> are stored in instructions_<f>, frame_<f> and eh_<f>.
+set(functions "")
+set(function "")
+set(section_kind "")
+file(STRINGS "${OUTPUT}" lines)
+foreach(line IN LISTS lines)
+  if(line MATCHES "^[ \t]*\\.section[ \t]+([^, \t]+)")
+    set(section "${CMAKE_MATCH_1}")
+    set(function "")
+    if(section MATCHES "^\\.text\\.unlikely\\.(.+)$")
+      set(section_kind text)
+      set(function "${CMAKE_MATCH_1}")
+    elseif(section MATCHES "^\\.text\\.(.+)$")
+      set(section_kind text)
+      set(function "${CMAKE_MATCH_1}")
+    elseif(section MATCHES "^\\.gcc_except_table\\.(.+)$")
+      set(section_kind eh)
+      set(function "${CMAKE_MATCH_1}")
+    endif()
+    if(function MATCHES "__(defer|manual)$" AND NOT function IN_LIST functions)
+      list(APPEND functions "${function}")
+      set(instructions_${function} 0)
+      set(frame_${function} 0)
+      set(eh_${function} 0)
+    endif()
+    continue()
+  endif()
+  if(NOT function MATCHES "__(defer|manual)$")
+    continue()
+  endif()
+  if(section_kind STREQUAL "text")
+    if(line MATCHES "^\t[a-z]")
+      math(EXPR instructions_${function} "${instructions_${function}} + 1")
+    elseif(line MATCHES "\\.cfi_def_cfa_offset[ \t]+([0-9]+)")
+      if(CMAKE_MATCH_1 GREATER frame_${function})
+        set(frame_${function} ${CMAKE_MATCH_1})
+      endif()
+    endif()
+  else()
+    if(line MATCHES "^[ \t]*\\.(byte|uleb128|sleb128)[ \t]")
+      math(EXPR eh_${function} "${eh_${function}} + 1")
+    elseif(line MATCHES "^[ \t]*\\.(value|short|2byte)[ \t]")
+      math(EXPR eh_${function} "${eh_${function}} + 2")
+    elseif(line MATCHES "^[ \t]*\\.(long|4byte)[ \t]")
+      math(EXPR eh_${function} "${eh_${function}} + 4")
+    elseif(line MATCHES "^[ \t]*\\.(quad|8byte)[ \t]")
+      math(EXPR eh_${function} "${eh_${function}} + 8")
+    endif()
+  endif()
+endforeach()
+
+set(failures "")
+set(cases 0)
+foreach(function IN LISTS functions)
+  if(NOT function MATCHES "^(.+)__defer$")
+    continue()
+  endif()
+  set(case "${CMAKE_MATCH_1}")
+  set(twin "${case}__manual")
+  if(NOT twin IN_LIST functions)
+    list(APPEND failures "${case}: no ${twin} function")
+    continue()
+  endif()
+  math(EXPR cases "${cases} + 1")
+  message(STATUS "${case}: instructions ${instructions_${function}}/${instructions_${twin}}, frame ${frame_${function}}/${frame_${twin}}, eh ${eh_${function}}/${eh_${twin}} (defer/manual)")
+  foreach(metric instructions frame eh)
+    if(metric STREQUAL "instructions")
+      set(slack ${MAX_EXTRA_INSTRUCTIONS})
+    elseif(metric STREQUAL "frame")
+      set(slack ${MAX_EXTRA_FRAME_BYTES})
+    else()
+      set(slack ${MAX_EXTRA_EH_BYTES})
+    endif()
+    math(EXPR limit "${${metric}_${twin}} + ${slack}")
+    if(${metric}_${function} GREATER limit)
+      list(APPEND failures "${case}: ${metric} ${${metric}_${function}} > ${${metric}_${twin}} + ${slack}")
+    endif()
+  endforeach()
+endforeach()
+
+if(cases EQUAL 0)
+  message(FATAL_ERROR "${OUTPUT}: no __defer/__manual function pairs found")
+endif()
+if(failures)
+  string(REPLACE ";" "\n  " failures "${failures}")
+  message(FATAL_ERROR "${OUTPUT}: defer constructs exceed their hand-written equivalents:\n  ${failures}")
+endif()
+message(STATUS "${OUTPUT}: ${cases} cases within the thresholds")
@@ -0,0 +1,49 @@
+
+// Reference functions for the "no landing pad" codegen check.
+// Each function uses an HNG_DT construct whose try block is noexcept,
+// so the generated code must not contain a landing pad or EH table entries,
+// even though the finally block calls a function which may throw.
+
+#include <hng/defer/defer.h>
+
+void release(int* p);
+
+int dt_noexcept_try_value(int* p) {
+    return HNG_DT_DEFER_FINALLY[&]
+    {
+        release(p);
+    }
+    HNG_DT_TRY[&]()noexcept
+    {
+        return *p + 1;
+    }
+    HNG_DT_END;
+}
+
+void dt_noexcept_try_void(int* p) {
+    HNG_DT_DEFER_FINALLY_PRESERVE[&]
+    {
+        release(p);
+    }
+    HNG_DT_TRY[&]()noexcept
+    {
+        ++*p;
+    }
+    HNG_DT_END;
+}
+
+int dt_noexcept_try_loop(int* p, int n) {
+    int sum = 0;
+    for (int i = 0; i < n; ++i) {
+        sum += HNG_DT_DEFER_FINALLY[&]
+        {
+            release(p + i);
+        }
+        HNG_DT_TRY[&]()noexcept
+        {
+            return p[i];
+        }
+        HNG_DT_END;
+    }
+    return sum;
+}
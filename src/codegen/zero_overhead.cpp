@@ -0,0 +1,203 @@
+// Reference functions for the "zero overhead" codegen check.
+// Each case is written twice: `<case>__defer` uses a defer construct,
+// and `<case>__manual` is the equivalent hand-written code.
+// The check compiles this file at -O2 and fails if a __defer function needs more instructions,
+// a larger stack frame or a larger EH table than its __manual twin.
+// The functions are extern "C" so that their symbols are the case names.
+
+#include <exception>
+#include <hng/defer/defer.h>
+
+void work(int* p);
+int compute(int* p);
+void cleanup(int* p) noexcept;
+
+namespace {
+    struct guard {
+        int* p;
+        ~guard() { cleanup(p); }
+    };
+
+    struct fail_guard {
+        int* p;
+        int uncaught_exceptions;
+        ~fail_guard() {
+            if (std::uncaught_exceptions() > uncaught_exceptions) {
+                cleanup(p);
+            }
+        }
+    };
+}
+
+extern "C" {
+
+    void defer_class__defer(int* p) {
+        auto const callable = [p]() noexcept { cleanup(p); };
+        hng::defer<decltype(callable)> const d(callable);
+        work(p);
+    }
+
+    void defer_class__manual(int* p) {
+        guard const g{ p };
+        work(p);
+    }
+
+    void defer_block__defer(int* p) {
+        HNG_DEFER_BLOCK({ cleanup(p); });
+        work(p);
+    }
+
+    void defer_block__manual(int* p) {
+        guard const g{ p };
+        work(p);
+    }
+
+    void defer_named__defer(int* p) {
+        HNG_DEFER_NAMED_BEGIN(release_p)
+        {
+            cleanup(p);
+        }
+        HNG_DEFER_NAMED_END(release_p);
+        work(p);
+    }
+
+    void defer_named__manual(int* p) {
+        guard const g{ p };
+        work(p);
+    }
+
+    void defer_callable_variable__defer(int* p) {
+        auto callable = [p]() noexcept { cleanup(p); };
+        HNG_DEFER_CALLABLE_VARIABLE(callable);
+        work(p);
+    }
+
+    void defer_callable_variable__manual(int* p) {
+        guard const g{ p };
+        work(p);
+    }
+
+    int defer_loop__defer(int* p, int n) {
+        int sum = 0;
+        for (int i = 0; i < n; ++i) {
+            HNG_DEFER_BLOCK({ cleanup(p + i); });
+            sum += compute(p + i);
+        }
+        return sum;
+    }
+
+    int defer_loop__manual(int* p, int n) {
+        int sum = 0;
+        for (int i = 0; i < n; ++i) {
+            guard const g{ p + i };
+            sum += compute(p + i);
+        }
+        return sum;
+    }
+
+    void defer_on_fail__defer(int* p) {
+        HNG_DEFER_ON_FAIL_BLOCK({ cleanup(p); });
+        work(p);
+    }
+
+    void defer_on_fail__manual(int* p) {
+        fail_guard const g{ p, std::uncaught_exceptions() };
+        work(p);
+    }
+
+    void dt_finally__defer(int* p) {
+        HNG_DT_DEFER_FINALLY[&]
+        {
+            cleanup(p);
+        }
+        HNG_DT_TRY[&]
+        {
+            work(p);
+        }
+        HNG_DT_END;
+    }
+
+    void dt_finally__manual(int* p) {
+        try {
+            work(p);
+        }
+        catch (...) {
+            cleanup(p);
+            throw;
+        }
+        cleanup(p);
+    }
+
+    int dt_finally_value__defer(int* p) {
+        return HNG_DT_DEFER_FINALLY[&]
+        {
+            cleanup(p);
+        }
+        HNG_DT_TRY[&]
+        {
+            return compute(p);
+        }
+        HNG_DT_END;
+    }
+
+    int dt_finally_value__manual(int* p) {
+        int result;
+        try {
+            result = compute(p);
+        }
+        catch (...) {
+            cleanup(p);
+            throw;
+        }
+        cleanup(p);
+        return result;
+    }
+
+    int dt_noexcept__defer(int* p) {
+        return HNG_DT_DEFER_FINALLY[&]
+        {
+            cleanup(p);
+        }
+        HNG_DT_TRY[&]()noexcept
+        {
+            return *p + 1;
+        }
+        HNG_DT_END;
+    }
+
+    int dt_noexcept__manual(int* p) {
+        int const result = *p + 1;
+        cleanup(p);
+        return result;
+    }
+
+    void dt_chain__defer(int* p) {
+        HNG_DT_CHAIN[&]()noexcept
+        {
+            cleanup(p);
+        }
+        HNG_DT_AND[&]()noexcept
+        {
+            cleanup(p + 1);
+        }
+        HNG_DT_TRY[&]
+        {
+            work(p);
+        }
+        HNG_DT_END;
+    }
+
+    void dt_chain__manual(int* p) {
+        try {
+            work(p);
+        }
+        catch (...) {
+            cleanup(p + 1);
+            cleanup(p);
+            throw;
+        }
+        cleanup(p + 1);
+        cleanup(p);
+    }
+
+}
@@ -1,11 +1,41 @@
 
+#include <algorithm>
 #include <array>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
 #include <vector>
 #include <memory>
 #include <functional>
+#include <initializer_list>
+#include <atomic>
+#include <mutex>
+#include <thread>
 #include <iostream>
+#include <sstream>
+#include <string>
 #include <type_traits>
 #include <hng/defer/defer.h>
+#include <hng/defer/defer_stack.h>
+#include <hng/defer/bulk_defer.h>
+#include <hng/defer/deferred_reclaimer.h>
+#include <hng/defer/async_defer.h>
+#include <hng/defer/defer_at_thread_exit.h>
+#include <hng/defer/co_defer.h>
+#include <hng/defer/undo_log.h>
+#include <hng/defer/unique_defer.h>
+#include <hng/defer/unique_resource.h>
+#include <hng/defer/parallel_defer.h>
+#include <hng/defer/scoped_arena.h>
+#include <hng/defer/shutdown_defer.h>
+#include <hng/defer/coalescing_scope.h>
+#include <hng/defer/deferred_lock_guard.h>
+#if DETAIL_HNG_UNIQUE_RESOURCE_HAS_POSIX
+#include <cerrno>
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/wait.h>
+#endif
 
 namespace hng {
     namespace defer_tests {
@@ -13,6 +43,7 @@ namespace hng {
         template<class F>
         bool test(char const*const name, F&& f) {
             bool success = false;
+#if DETAIL_HNG_DEFER_HAS_EXCEPTIONS
             try {
                 success = std::invoke(std::forward<F>(f), std::as_const(name));
             }
@@ -20,12 +51,204 @@ namespace hng {
                 std::cerr << "Test failed: Test named \"" << name << "\" failed" << std::endl;
                 return false;
             }
+#else
+            success = std::invoke(std::forward<F>(f), std::as_const(name));
+#endif // ^^^^ DETAIL_HNG_DEFER_HAS_EXCEPTIONS
             if (!success) {
                 std::cerr << "Test failed: Test named \"" << name << "\" failed" << std::endl;
             }
             return success;
         }
 
+        // Counts constructions, copies, moves and live instances.
+        struct counted {
+            static int constructions;
+            static int copies;
+            static int moves;
+            static int live;
+            static void reset() { constructions = copies = moves = live = 0; }
+            std::array<int, 64> payload;
+            explicit counted(int value) : payload() { payload[0] = value; ++constructions; ++live; }
+            counted(counted const& other) : payload(other.payload) { ++constructions; ++copies; ++live; }
+            counted(counted&& other) noexcept : payload(other.payload) { ++constructions; ++moves; ++live; }
+            ~counted() { --live; }
+        };
+        int counted::constructions = 0;
+        int counted::copies = 0;
+        int counted::moves = 0;
+        int counted::live = 0;
+
+        // A node whose deleter only marks it as freed, so readers can detect premature reclamation.
+        struct reclaimed_node {
+            std::atomic<bool> freed{ false };
+            int value = 0;
+
+            static std::mutex graveyard_mutex;
+            static std::vector<reclaimed_node*> graveyard;
+
+            static void mark_freed(void* p) noexcept {
+                auto* const n = static_cast<reclaimed_node*>(p);
+                n->freed.store(true, std::memory_order_relaxed);
+                std::lock_guard<std::mutex> const lock(graveyard_mutex);
+                graveyard.push_back(n);
+            }
+
+            static void bury() {
+                for (auto* const n : graveyard) {
+                    delete n;
+                }
+                graveyard.clear();
+            }
+        };
+        std::mutex reclaimed_node::graveyard_mutex;
+        std::vector<reclaimed_node*> reclaimed_node::graveyard;
+
+#if DETAIL_HNG_DEFER_HAS_COROUTINES
+        // A single-threaded event loop: awaiting `yield()` suspends the coroutine until the loop resumes it.
+        struct manual_loop {
+            std::vector<std::coroutine_handle<>> ready;
+
+            struct yield_awaiter {
+                manual_loop& loop;
+                bool await_ready() const noexcept { return false; }
+                void await_suspend(std::coroutine_handle<> h) const { loop.ready.push_back(h); }
+                void await_resume() const noexcept {}
+            };
+
+            yield_awaiter yield() { return yield_awaiter{ *this }; }
+
+            void run() {
+                while (!ready.empty()) {
+                    auto const h = ready.front();
+                    ready.erase(ready.begin());
+                    h.resume();
+                }
+            }
+        };
+
+        // A coroutine which starts immediately and is never awaited.
+        struct detached_coroutine {
+            struct promise_type {
+                detached_coroutine get_return_object() noexcept { return {}; }
+                std::suspend_never initial_suspend() noexcept { return {}; }
+                std::suspend_never final_suspend() noexcept { return {}; }
+                void return_void() noexcept {}
+                void unhandled_exception() noexcept { std::terminate(); }
+            };
+        };
+#endif // ^^^^ DETAIL_HNG_DEFER_HAS_COROUTINES
+
+        // Neither copyable nor movable.
+        struct pinned {
+            int value;
+            explicit pinned(int v) : value(v) {}
+            pinned(pinned const&) = delete;
+            pinned(pinned&&) = delete;
+            pinned& operator=(pinned const&) = delete;
+            pinned& operator=(pinned&&) = delete;
+        };
+
+        // A stateless deleter which records the handles it closes.
+        struct recorded_close {
+            static std::vector<int> closed;
+            static constexpr int invalid() noexcept { return -1; }
+            void operator()(int handle) const noexcept { closed.push_back(handle); }
+        };
+        std::vector<int> recorded_close::closed;
+
+#if DETAIL_HNG_DEFER_HAS_CPP20_CONSTEXPR && !defined(HNG_DEFER_INSTRUMENT)
+        // Records events during constant evaluation.
+        struct constexpr_log {
+            std::array<int, 16> events{};
+            std::size_t size = 0;
+            constexpr void push(int event) { events[size++] = event; }
+            constexpr bool equals(std::initializer_list<int> expected) const {
+                if (expected.size() != size)
+                    return false;
+                std::size_t i = 0;
+                for (int const event : expected) {
+                    if (events[i++] != event)
+                        return false;
+                }
+                return true;
+            }
+        };
+
+        // Not trivially copyable, so a HNG_DT construct returning it takes the guard path.
+        struct constexpr_value {
+            int value;
+            constexpr explicit constexpr_value(int v) : value(v) {}
+            constexpr ~constexpr_value() {}
+        };
+
+        constexpr constexpr_log constexpr_defer_order() {
+            constexpr_log log;
+            {
+                auto const first = [&]() noexcept { log.push(1); };
+                hng::defer<decltype(first)> const first_defer(first);
+                HNG_DEFER_BLOCK(log.push(2););
+                HNG_DEFER_BEGIN
+                {
+                    log.push(3);
+                }
+                HNG_DEFER_END;
+                HNG_DEFER_ON_FAIL_BLOCK(log.push(-1););
+                HNG_DEFER_ON_SUCCESS_BLOCK(log.push(4););
+                log.push(0);
+            }
+            return log;
+        }
+
+        constexpr constexpr_log constexpr_dt_order() {
+            constexpr_log log;
+            int const value = HNG_DT_DEFER_FINALLY[&]
+            {
+                log.push(2);
+            }
+            HNG_DT_TRY[&]
+            {
+                log.push(1);
+                return 10;
+            }
+            HNG_DT_END;
+            log.push(value);
+            constexpr_value const guarded = HNG_DT_DEFER_FINALLY_PRESERVE[&]
+            {
+                log.push(4);
+            }
+            HNG_DT_TRY[&]
+            {
+                log.push(3);
+                return constexpr_value(11);
+            }
+            HNG_DT_END;
+            log.push(guarded.value);
+            HNG_DT_DEFER_FINALLY_AGGREGATE[&]
+            {
+                log.push(6);
+            }
+            HNG_DT_TRY[&]() noexcept
+            {
+                log.push(5);
+            }
+            HNG_DT_END;
+            HNG_DT_CHAIN[&]
+            {
+                log.push(9);
+            }
+            HNG_DT_AND[&]
+            {
+                log.push(8);
+            }
+            HNG_DT_TRY[&]
+            {
+                log.push(7);
+            }
+            HNG_DT_END;
+            return log;
+        }
+#endif // ^^^^ DETAIL_HNG_DEFER_HAS_CPP20_CONSTEXPR
+
         void run_tests() {
             std::vector<std::function<bool()>> tests;
 
@@ -46,6 +269,7 @@ namespace hng {
                     return x == 0 && xd == 2;
                 }
                 }); });
+#if DETAIL_HNG_DEFER_HAS_EXCEPTIONS
             tests.emplace_back([] { return test("HNG_DT DEFER_FINALLY/TRY/END macros - try block exception", [](auto const& /*test_name*/) {
                 {
                     int x = 1;
@@ -68,6 +292,7 @@ namespace hng {
                     return x == 0;
                 }
                 }); });
+#endif // ^^^^ DETAIL_HNG_DEFER_HAS_EXCEPTIONS
             tests.emplace_back([] { return test("HNG_DT DEFER_FINALLY/TRY/END macros - try block return", [](auto const& /*test_name*/) {
                 {
                     int x = 1;
@@ -159,6 +384,7 @@ namespace hng {
                     return z == 2 && r && *r == 3 && &r == &x;
                 }
                 }); });
+#if DETAIL_HNG_DEFER_HAS_EXCEPTIONS
             tests.emplace_back([] { return test("HNG_DT DEFER_FINALLY_PRESERVE/TRY/END macros - try block exception", [](auto const& /*test_name*/) {
                 {
                     int x = 1;
@@ -233,6 +459,344 @@ namespace hng {
                     return true;
                 }
                 }); });
+            tests.emplace_back([] { return test("HNG_DT DEFER_FINALLY_AGGREGATE/TRY/END macros - try block exception and defer block exception", [](auto const& /*test_name*/) {
+                {
+                    try {
+                        HNG_DT_DEFER_FINALLY_AGGREGATE[&]
+                        {
+                            throw std::runtime_error("e2");
+                        }
+                            HNG_DT_TRY[&]
+                        {
+                            throw std::logic_error("e1");
+                        }
+                        HNG_DT_END;
+                    }
+                    catch (hng::defer_aggregate_exception const& aex) {
+                        if (aex.size() != 2)
+                            return false;
+                        try {
+                            std::rethrow_exception(aex.exceptions()[0]);
+                        }
+                        catch (std::logic_error const& ex) {
+                            if (!(0 == std::strcmp(ex.what(), "e1")))
+                                return false;
+                        }
+                        try {
+                            std::rethrow_exception(aex.exception_ptr());
+                        }
+                        catch (std::runtime_error const& ex) {
+                            if (!(0 == std::strcmp(ex.what(), "e2")))
+                                return false;
+                        }
+                        return aex.exceptions()[1] == aex.exception_ptr();
+                    }
+                    return false;
+                }
+                }); });
+            tests.emplace_back([] { return test("HNG_DT DEFER_FINALLY_AGGREGATE/TRY/END macros - single exceptions propagate as-is", [](auto const& /*test_name*/) {
+                {
+                    int x = 1;
+                    try {
+                        HNG_DT_DEFER_FINALLY_AGGREGATE[&]
+                        {
+                            x = 0;
+                        }
+                            HNG_DT_TRY[&]
+                        {
+                            throw std::runtime_error("try");
+                        }
+                        HNG_DT_END;
+                    }
+                    catch (hng::defer_exception const&) {
+                        return false;
+                    }
+                    catch (std::runtime_error const&) {
+                    }
+                    try {
+                        HNG_DT_DEFER_FINALLY_AGGREGATE[&]
+                        {
+                            throw std::runtime_error("defer");
+                        }
+                            HNG_DT_TRY[&]
+                        {
+                            x = 2;
+                        }
+                        HNG_DT_END;
+                    }
+                    catch (hng::defer_exception const&) {
+                        return false;
+                    }
+                    catch (std::runtime_error const& ex) {
+                        if (!(0 == std::strcmp(ex.what(), "defer")))
+                            return false;
+                    }
+                    return x == 2;
+                }
+                }); });
+            tests.emplace_back([] { return test("defer_aggregate_exception class - collects exceptions from catch blocks", [](auto const& /*test_name*/) {
+                {
+                    hng::defer_aggregate_exception errors;
+                    errors.throw_if_any();
+                    for (int i = 0; i < 5; ++i) {
+                        try {
+                            if (i % 2 == 0)
+                                throw i;
+                        }
+                        catch (...) {
+                            errors.add(std::current_exception());
+                        }
+                    }
+                    try {
+                        errors.throw_if_any();
+                    }
+                    catch (hng::defer_exception const& ex) {
+                        auto const& aex = dynamic_cast<hng::defer_aggregate_exception const&>(ex);
+                        int sum = 0;
+                        for (auto const& e : aex.exceptions()) {
+                            try {
+                                std::rethrow_exception(e);
+                            }
+                            catch (int i) {
+                                sum += i;
+                            }
+                        }
+                        return aex.size() == 3 && sum == 6;
+                    }
+                    return false;
+                }
+                }); });
+#endif // ^^^^ DETAIL_HNG_DEFER_HAS_EXCEPTIONS
+            tests.emplace_back([] { return test("HNG_DT DEFER_FINALLY/TRY/END macros - noexcept try block", [](auto const& /*test_name*/) {
+                {
+                    auto a = std::vector<int>();
+                    int y = HNG_DT_DEFER_FINALLY[&]
+                    {
+                        a.push_back(2);
+                    }
+                        HNG_DT_TRY[&]()noexcept
+                    {
+                        a.push_back(1);
+                        return 3;
+                    }
+                    HNG_DT_END;
+                    HNG_DT_DEFER_FINALLY_PRESERVE[&]
+                    {
+                        a.push_back(4);
+                    }
+                        HNG_DT_TRY[&]()noexcept
+                    {
+                        a.push_back(y);
+                    }
+                    HNG_DT_END;
+                    std::vector<int> expected{ 1, 2, 3, 4 };
+                    return a == expected;
+                }
+                }); });
+#if DETAIL_HNG_DEFER_HAS_EXCEPTIONS
+            tests.emplace_back([] { return test("HNG_DT DEFER_FINALLY/TRY/END macros - noexcept try block and defer block exception", [](auto const& /*test_name*/) {
+                {
+                    int x = 1;
+                    try {
+                        HNG_DT_DEFER_FINALLY_PRESERVE[&]
+                        {
+                            throw std::runtime_error("test");
+                        }
+                            HNG_DT_TRY[&]()noexcept
+                        {
+                            x = 2;
+                        }
+                        HNG_DT_END;
+                        return false;
+                    }
+                    catch (std::runtime_error const& ex) {
+                        if (!(0 == std::strcmp(ex.what(), "test")))
+                            return false;
+                    }
+                    return x == 2;
+                }
+                }); });
+#endif // ^^^^ DETAIL_HNG_DEFER_HAS_EXCEPTIONS
+#if DETAIL_HNG_DEFER_HAS_CPP17
+            tests.emplace_back([] { return test("HNG_DT DEFER_FINALLY/TRY/END macros - expression return value is constructed once", [](auto const& /*test_name*/) {
+                {
+                    counted::reset();
+                    int z = 1;
+                    {
+                        counted r = HNG_DT_DEFER_FINALLY[&]()noexcept
+                        {
+                            z = 2;
+                        }
+                            HNG_DT_TRY[&]
+                        {
+                            return counted(3);
+                        }
+                        HNG_DT_END;
+                        if (!(z == 2 && r.payload[0] == 3 && counted::constructions == 1 && counted::copies == 0 && counted::moves == 0))
+                            return false;
+                        counted q = HNG_DT_DEFER_FINALLY_PRESERVE[&]()noexcept
+                        {
+                            z = 3;
+                        }
+                            HNG_DT_TRY[&]()noexcept
+                        {
+                            return counted(4);
+                        }
+                        HNG_DT_END;
+                        if (!(z == 3 && q.payload[0] == 4 && counted::constructions == 2 && counted::copies == 0 && counted::moves == 0))
+                            return false;
+                        // A finally block which can throw is invoked before the result is returned, at the cost of at most one move.
+                        counted m = HNG_DT_DEFER_FINALLY[&]
+                        {
+                            z = 4;
+                        }
+                            HNG_DT_TRY[&]
+                        {
+                            return counted(5);
+                        }
+                        HNG_DT_END;
+                        if (!(z == 4 && m.payload[0] == 5 && counted::copies == 0 && counted::moves <= 1))
+                            return false;
+                    }
+                    return counted::live == 0;
+                }
+                }); });
+            tests.emplace_back([] { return test("HNG_DT DEFER_FINALLY/TRY/END macros - expression return value by move is moved once before the defer block", [](auto const& /*test_name*/) {
+                {
+                    counted::reset();
+                    counted x(5);
+                    int seen = 0;
+                    {
+                        counted r = HNG_DT_DEFER_FINALLY[&]()noexcept
+                        {
+                            // executed after the result was moved out of x.
+                            seen = x.payload[0];
+                            x.payload[0] = 0;
+                        }
+                            HNG_DT_TRY[&]() -> counted&&
+                        {
+                            return std::move(x);
+                        }
+                        HNG_DT_END;
+                        if (!(r.payload[0] == 5 && seen == 5 && counted::copies == 0 && counted::moves == 1))
+                            return false;
+                    }
+                    return counted::live == 1;
+                }
+                }); });
+            tests.emplace_back([] { return test("HNG_DT DEFER_FINALLY/TRY/END macros - non-movable expression return value", [](auto const& /*test_name*/) {
+                {
+                    int z = 1;
+                    pinned const p = HNG_DT_DEFER_FINALLY[&]
+                    {
+                        z = 2;
+                    }
+                        HNG_DT_TRY[&]
+                    {
+                        return pinned(7);
+                    }
+                    HNG_DT_END;
+                    return z == 2 && p.value == 7;
+                }
+                }); });
+#if DETAIL_HNG_DEFER_HAS_EXCEPTIONS
+            tests.emplace_back([] { return test("HNG_DT DEFER_FINALLY/TRY/END macros - defer block exception destroys the expression return value", [](auto const& /*test_name*/) {
+                {
+                    counted::reset();
+                    try {
+                        counted r = HNG_DT_DEFER_FINALLY[&]
+                        {
+                            throw std::runtime_error("test");
+                        }
+                            HNG_DT_TRY[&]
+                        {
+                            return counted(3);
+                        }
+                        HNG_DT_END;
+                        return false;
+                    }
+                    catch (std::runtime_error const& ex) {
+                        if (!(0 == std::strcmp(ex.what(), "test")))
+                            return false;
+                    }
+                    if (!(counted::constructions == 1 && counted::live == 0))
+                        return false;
+                    // A result which owns heap memory is freed once.
+                    try {
+                        std::string r = HNG_DT_DEFER_FINALLY[&]
+                        {
+                            throw std::runtime_error("test");
+                        }
+                            HNG_DT_TRY[&]
+                        {
+                            return std::string(64, 'x');
+                        }
+                        HNG_DT_END;
+                        return false;
+                    }
+                    catch (std::runtime_error const&) {
+                    }
+                    return true;
+                }
+                }); });
+#endif // ^^^^ DETAIL_HNG_DEFER_HAS_EXCEPTIONS
+#endif // ^^^^ DETAIL_HNG_DEFER_HAS_CPP17
+#if DETAIL_HNG_DEFER_HAS_EXCEPTIONS
+            tests.emplace_back([] { return test("HNG_DT DEFER_FINALLY/TRY/END macros - defer block runs when copying a try block capture throws", [](auto const& /*test_name*/) {
+                {
+                    struct throws_on_copy {
+                        throws_on_copy() = default;
+                        throws_on_copy(throws_on_copy const&) { throw std::runtime_error("copy"); }
+                    };
+                    throws_on_copy const capture;
+                    int x = 0;
+                    try {
+                        HNG_DT_DEFER_FINALLY[&]
+                        {
+                            x = 1;
+                        }
+                            HNG_DT_TRY[&, capture]
+                        {
+                            static_cast<void>(capture);
+                            x = 2;
+                        }
+                        HNG_DT_END;
+                        return false;
+                    }
+                    catch (std::runtime_error const& ex) {
+                        if (!(0 == std::strcmp(ex.what(), "copy") && x == 1))
+                            return false;
+                    }
+                    // Also when the try block is noexcept, and when the finally block throws too.
+                    x = 0;
+                    try {
+                        HNG_DT_DEFER_FINALLY_PRESERVE[&]
+                        {
+                            x = 3;
+                            throw std::runtime_error("finally");
+                        }
+                            HNG_DT_TRY[&, capture]() noexcept
+                        {
+                            static_cast<void>(capture);
+                            x = 4;
+                        }
+                        HNG_DT_END;
+                        return false;
+                    }
+                    catch (hng::defer_exception const& ex) {
+                        if (x != 3)
+                            return false;
+                        try {
+                            std::rethrow_if_nested(ex);
+                        }
+                        catch (std::runtime_error const& nested) {
+                            return 0 == std::strcmp(nested.what(), "copy");
+                        }
+                    }
+                    return false;
+                }
+                }); });
+#endif // ^^^^ DETAIL_HNG_DEFER_HAS_EXCEPTIONS
             tests.emplace_back([] { return test("defer class - basic", [](auto const& /*test_name*/) {
                 {
                     int* raw_ptr = new int(4);
@@ -337,6 +901,1663 @@ namespace hng {
                 }
                 }); });
 
+#if DETAIL_HNG_DEFER_HAS_UNCAUGHT_EXCEPTIONS
+            tests.emplace_back([] { return test("defer_on_fail/defer_on_success classes - scope exits normally", [](auto const& /*test_name*/) {
+                {
+                    int fail = 0;
+                    int success = 0;
+                    {
+                        auto const on_fail = [&]()noexcept { ++fail; };
+                        auto const on_success = [&]()noexcept { ++success; };
+                        hng::defer_on_fail<decltype(on_fail)> const my_fail_defer(on_fail);
+                        hng::defer_on_success<decltype(on_success)> const my_success_defer(on_success);
+                    }
+                    return fail == 0 && success == 1;
+                }
+                }); });
+#if DETAIL_HNG_DEFER_HAS_EXCEPTIONS
+            tests.emplace_back([] { return test("defer_on_fail/defer_on_success classes - scope exits by exception", [](auto const& /*test_name*/) {
+                {
+                    int fail = 0;
+                    int success = 0;
+                    try {
+                        auto const on_fail = [&]()noexcept { ++fail; };
+                        auto const on_success = [&]()noexcept { ++success; };
+                        hng::defer_on_fail<decltype(on_fail)> const my_fail_defer(on_fail);
+                        hng::defer_on_success<decltype(on_success)> const my_success_defer(on_success);
+                        throw std::runtime_error("test");
+                    }
+                    catch (std::runtime_error const&) {
+                    }
+                    return fail == 1 && success == 0;
+                }
+                }); });
+            tests.emplace_back([] { return test("defer_on_fail/defer_on_success classes - scope inside a destructor during stack unwinding", [](auto const& /*test_name*/) {
+                {
+                    struct unwinder {
+                        int* fail;
+                        int* success;
+                        ~unwinder() {
+                            HNG_DEFER_ON_FAIL_BLOCK({ ++*fail; });
+                            HNG_DEFER_ON_SUCCESS_BLOCK({ ++*success; });
+                        }
+                    };
+                    int fail = 0;
+                    int success = 0;
+                    try {
+                        unwinder const u{ &fail, &success };
+                        throw std::runtime_error("test");
+                    }
+                    catch (std::runtime_error const&) {
+                    }
+                    return fail == 0 && success == 1;
+                }
+                }); });
+            tests.emplace_back([] { return test("HNG_DEFER_ON_FAIL/HNG_DEFER_ON_SUCCESS macros", [](auto const& /*test_name*/) {
+                {
+                    auto a = std::vector<int>();
+                    auto const commit_or_rollback = [&](bool should_throw) {
+                        HNG_DEFER_ON_FAIL_NAMED_BEGIN(rollback)
+                        {
+                            a.push_back(-1);
+                        }
+                        HNG_DEFER_ON_FAIL_NAMED_END(rollback);
+                        auto commit = [&]()noexcept { a.push_back(1); };
+                        HNG_DEFER_ON_SUCCESS_CALLABLE_VARIABLE(commit);
+                        if (should_throw)
+                            throw std::runtime_error("test");
+                    };
+                    commit_or_rollback(false);
+                    try {
+                        commit_or_rollback(true);
+                    }
+                    catch (std::runtime_error const&) {
+                    }
+                    std::vector<int> expected{ 1, -1 };
+                    return a == expected;
+                }
+                }); });
+#endif // ^^^^ DETAIL_HNG_DEFER_HAS_EXCEPTIONS
+#endif // ^^^^ DETAIL_HNG_DEFER_HAS_UNCAUGHT_EXCEPTIONS
+
+#if DETAIL_HNG_DEFER_HAS_CPP17
+#if DETAIL_HNG_DEFER_HAS_EXCEPTIONS
+            tests.emplace_back([] { return test("HNG_DEFER_ON_FAIL/HNG_DEFER_ON_SUCCESS BEGIN/END macros", [](auto const& /*test_name*/) {
+                {
+                    int fail = 0;
+                    int success = 0;
+                    try {
+                        HNG_DEFER_ON_FAIL_BEGIN
+                        {
+                            ++fail;
+                        }
+                        HNG_DEFER_ON_FAIL_END;
+                        HNG_DEFER_ON_SUCCESS_BEGIN
+                        {
+                            ++success;
+                        }
+                        HNG_DEFER_ON_SUCCESS_END;
+                        throw std::runtime_error("test");
+                    }
+                    catch (std::runtime_error const&) {
+                    }
+                    return fail == 1 && success == 0;
+                }
+                }); });
+#endif // ^^^^ DETAIL_HNG_DEFER_HAS_EXCEPTIONS
+#endif // ^^^^ DETAIL_HNG_DEFER_HAS_CPP17
+
+            tests.emplace_back([] { return test("defer_stack class - LIFO order", [](auto const& /*test_name*/) {
+                {
+                    auto a = std::vector<int>();
+                    {
+                        hng::defer_stack cleanup;
+                        for (int i = 0; i < 3; ++i) {
+                            cleanup.push([&a, i]()noexcept { a.push_back(i); });
+                        }
+                        if (!(cleanup.size() == 3 && a.empty()))
+                            return false;
+                    }
+                    std::vector<int> expected{ 2, 1, 0 };
+                    return a == expected;
+                }
+                }); });
+            tests.emplace_back([] { return test("defer_stack class - pop and release", [](auto const& /*test_name*/) {
+                {
+                    auto a = std::vector<int>();
+                    auto const counter = std::make_shared<int>(0);
+                    {
+                        hng::defer_stack cleanup;
+                        cleanup.push([&a]()noexcept { a.push_back(1); });
+                        cleanup.push([&a]()noexcept { a.push_back(2); });
+                        cleanup.pop();
+                        if (!(cleanup.size() == 1 && a == std::vector<int>{ 2 }))
+                            return false;
+                        cleanup.push([&a, counter]()noexcept { a.push_back(3); });
+                        cleanup.release();
+                        if (!(cleanup.empty() && counter.use_count() == 1))
+                            return false;
+                        cleanup.push([&a]()noexcept { a.push_back(4); });
+                    }
+                    std::vector<int> expected{ 2, 4 };
+                    return a == expected;
+                }
+                }); });
+            tests.emplace_back([] { return test("defer_stack class - spills beyond the inline buffer", [](auto const& /*test_name*/) {
+                {
+                    auto a = std::vector<int>();
+                    {
+                        hng::basic_defer_stack<64> cleanup;
+                        for (int i = 0; i < 1000; ++i) {
+                            cleanup.push([&a, i]()noexcept { a.push_back(i); });
+                        }
+                        for (int i = 0; i < 600; ++i) {
+                            cleanup.pop();
+                        }
+                        for (int i = 400; i < 1000; ++i) {
+                            cleanup.push([&a, i]()noexcept { a.push_back(i); });
+                        }
+                        if (cleanup.size() != 1000)
+                            return false;
+                        a.clear();
+                    }
+                    if (a.size() != 1000)
+                        return false;
+                    for (int i = 0; i < 1000; ++i) {
+                        if (a[i] != 999 - i)
+                            return false;
+                    }
+                    return true;
+                }
+                }); });
+#if DETAIL_HNG_DEFER_HAS_EXCEPTIONS
+            tests.emplace_back([] { return test("defer_stack class - an oversized entry throws std::bad_alloc", [](auto const& /*test_name*/) {
+                {
+                    // No callable type is large enough to overflow the chunk size, so the entry is allocated directly.
+                    hng::detail::defer_stack::arena<64> arena;
+                    unsigned char* const first = static_cast<unsigned char*>(arena.allocate(16, alignof(std::max_align_t)));
+                    for (std::size_t const size : { std::size_t(-1), std::size_t(-1) - 64 }) {
+                        try {
+                            arena.allocate(size, alignof(std::max_align_t));
+                            return false;
+                        }
+                        catch (std::bad_alloc const&) {
+                        }
+                    }
+                    return arena.allocate(16, alignof(std::max_align_t)) == first + 16;
+                }
+                }); });
+#endif // ^^^^ DETAIL_HNG_DEFER_HAS_EXCEPTIONS
+
+            tests.emplace_back([] { return test("bulk_defer class - one batch at the end of the scope", [](auto const& /*test_name*/) {
+                {
+                    auto batches = std::vector<std::vector<int>>();
+                    {
+                        auto const release = [&](hng::bulk_span<int> handles)noexcept {
+                            batches.emplace_back(handles.begin(), handles.end());
+                        };
+                        hng::bulk_defer<int, 8, decltype(release)> handles_defer(release);
+                        handles_defer.push(1);
+                        handles_defer.push(2);
+                        handles_defer.emplace(3);
+                        if (!(handles_defer.size() == 3 && batches.empty()))
+                            return false;
+                    }
+                    std::vector<std::vector<int>> expected{ { 1, 2, 3 } };
+                    return batches == expected;
+                }
+                }); });
+            tests.emplace_back([] { return test("bulk_defer class - flushes early when full", [](auto const& /*test_name*/) {
+                {
+                    auto batches = std::vector<std::vector<int>>();
+                    {
+                        auto const release = [&](hng::bulk_span<int> handles)noexcept {
+                            batches.emplace_back(handles.begin(), handles.end());
+                        };
+                        hng::bulk_defer<int, 4, decltype(release)> handles_defer(release);
+                        for (int i = 0; i < 10; ++i) {
+                            handles_defer.push(i);
+                        }
+                        if (batches.size() != 2)
+                            return false;
+                    }
+                    std::vector<std::vector<int>> expected{ { 0, 1, 2, 3 }, { 4, 5, 6, 7 }, { 8, 9 } };
+                    return batches == expected;
+                }
+                }); });
+            tests.emplace_back([] { return test("bulk_defer class - flush and release", [](auto const& /*test_name*/) {
+                {
+                    auto batches = std::vector<std::vector<int>>();
+                    auto const counter = std::make_shared<int>(0);
+                    {
+                        auto const release = [&](hng::bulk_span<std::shared_ptr<int>> handles)noexcept {
+                            batches.emplace_back();
+                            for (auto const& handle : handles) {
+                                batches.back().push_back(static_cast<int>(handle.use_count()));
+                            }
+                        };
+                        hng::bulk_defer<std::shared_ptr<int>, 4, decltype(release)> handles_defer(release);
+                        handles_defer.push(counter);
+                        handles_defer.flush();
+                        if (!(handles_defer.empty() && counter.use_count() == 1 && batches.size() == 1))
+                            return false;
+                        handles_defer.push(counter);
+                        handles_defer.release();
+                        if (!(handles_defer.empty() && counter.use_count() == 1))
+                            return false;
+                    }
+                    std::vector<std::vector<int>> expected{ { 2 } };
+                    return batches == expected;
+                }
+                }); });
+#if DETAIL_HNG_DEFER_HAS_CPP17
+            tests.emplace_back([] { return test("deferred_reclaimer class - objects are freed after the epoch advances", [](auto const& /*test_name*/) {
+                {
+                    hng::deferred_reclaimer reclaimer;
+                    auto* const n = new reclaimed_node();
+                    {
+                        auto const guard = reclaimer.pin();
+                        {
+                            hng::deferred_reclaimer::read_guard const nested_guard(reclaimer);
+                            reclaimer.retire(n, &reclaimed_node::mark_freed);
+                        }
+                        for (int i = 0; i < 4; ++i) {
+                            reclaimer.collect();
+                        }
+                        if (n->freed.load() || reclaimer.pending() != 1)
+                            return false;
+                    }
+                    for (int i = 0; i < 4; ++i) {
+                        reclaimer.collect();
+                    }
+                    bool const freed = n->freed.load() && reclaimer.pending() == 0;
+                    reclaimed_node::bury();
+                    return freed;
+                }
+                }); });
+            tests.emplace_back([] { return test("deferred_reclaimer class - retire with a default deleter", [](auto const& /*test_name*/) {
+                {
+                    auto const counter = std::make_shared<int>(0);
+                    {
+                        hng::deferred_reclaimer reclaimer;
+                        reclaimer.retire(new std::shared_ptr<int>(counter));
+                        reclaimer.retire(new std::shared_ptr<int>(counter));
+                        if (counter.use_count() != 3)
+                            return false;
+                        for (int i = 0; i < 4; ++i) {
+                            reclaimer.collect();
+                        }
+                    }
+                    return counter.use_count() == 1;
+                }
+                }); });
+            tests.emplace_back([] { return test("deferred_reclaimer class - multi-threaded stress", [](auto const& /*test_name*/) {
+                {
+                    hng::deferred_reclaimer reclaimer(64);
+                    std::atomic<reclaimed_node*> head{ new reclaimed_node() };
+                    std::atomic<bool> premature{ false };
+                    std::atomic<long long> reads{ 0 };
+                    constexpr int iterations = 20000;
+
+                    auto threads = std::vector<std::thread>();
+                    for (int t = 0; t < 4; ++t) {
+                        threads.emplace_back([&] {
+                            long long sum = 0;
+                            for (int i = 0; i < iterations; ++i) {
+                                auto const guard = reclaimer.pin();
+                                reclaimed_node* const n = head.load(std::memory_order_acquire);
+                                if (n->freed.load(std::memory_order_relaxed))
+                                    premature.store(true);
+                                sum += n->value;
+                                if (n->freed.load(std::memory_order_relaxed))
+                                    premature.store(true);
+                            }
+                            reads += sum;
+                        });
+                    }
+                    for (int t = 0; t < 2; ++t) {
+                        threads.emplace_back([&, t] {
+                            for (int i = 0; i < iterations; ++i) {
+                                auto* const n = new reclaimed_node();
+                                n->value = t;
+                                reclaimer.retire(head.exchange(n, std::memory_order_acq_rel), &reclaimed_node::mark_freed);
+                            }
+                            reclaimer.collect();
+                        });
+                    }
+                    for (auto& thread : threads) {
+                        thread.join();
+                    }
+                    for (int i = 0; i < 4; ++i) {
+                        reclaimer.collect();
+                    }
+                    std::size_t freed = 0;
+                    {
+                        std::lock_guard<std::mutex> const lock(reclaimed_node::graveyard_mutex);
+                        freed = reclaimed_node::graveyard.size();
+                    }
+                    delete head.load();
+                    reclaimed_node::bury();
+                    return !premature.load() && freed == 2 * iterations;
+                }
+                }); });
+#endif // ^^^^ DETAIL_HNG_DEFER_HAS_CPP17
+#if DETAIL_HNG_DEFER_HAS_CPP17
+            tests.emplace_back([] { return test("async_defer class - the callable runs on the worker after the scope", [](auto const& /*test_name*/) {
+                {
+                    hng::async_defer_executor executor;
+                    auto const caller = std::this_thread::get_id();
+                    std::thread::id runner;
+                    auto owned = std::make_unique<std::vector<int>>(1000, 7);
+                    std::vector<int> const& view = *owned;
+                    {
+                        hng::async_defer const release(executor, [owned = std::move(owned), &runner]() mutable noexcept {
+                            runner = std::this_thread::get_id();
+                            owned.reset();
+                        });
+                        if (view.size() != 1000)
+                            return false;
+                    }
+                    executor.flush();
+                    return runner != std::thread::id() && runner != caller && executor.pending() == 0;
+                }
+                }); });
+            tests.emplace_back([] { return test("async_defer class - cleanups run in submission order", [](auto const& /*test_name*/) {
+                {
+                    std::vector<int> order;
+                    {
+                        hng::async_defer_executor executor;
+                        for (int i = 0; i < 100; ++i) {
+                            hng::async_defer const push(executor, [&order, i]() noexcept { order.push_back(i); });
+                        }
+                    }
+                    if (order.size() != 100)
+                        return false;
+                    for (int i = 0; i < 100; ++i) {
+                        if (order[static_cast<std::size_t>(i)] != i)
+                            return false;
+                    }
+                    return true;
+                }
+                }); });
+            tests.emplace_back([] { return test("async_defer class - a full queue runs cleanups inline with run_inline", [](auto const& /*test_name*/) {
+                {
+                    hng::async_defer_config config;
+                    config.capacity = 1;
+                    config.overflow = hng::async_defer_overflow::run_inline;
+                    hng::async_defer_executor executor(config);
+                    std::atomic<bool> release_worker{ false };
+                    executor.submit([&release_worker]() noexcept {
+                        while (!release_worker.load()) {
+                            std::this_thread::yield();
+                        }
+                    });
+                    std::thread::id runner;
+                    executor.submit([&runner]() noexcept { runner = std::this_thread::get_id(); });
+                    release_worker = true;
+                    executor.flush();
+                    return runner == std::this_thread::get_id();
+                }
+                }); });
+            tests.emplace_back([] { return test("async_defer class - a full queue blocks producers", [](auto const& /*test_name*/) {
+                {
+                    hng::async_defer_config config;
+                    config.capacity = 2;
+                    hng::async_defer_executor executor(config);
+                    std::atomic<int> runs{ 0 };
+                    std::atomic<bool> over_capacity{ false };
+                    auto producers = std::vector<std::thread>();
+                    for (int t = 0; t < 4; ++t) {
+                        producers.emplace_back([&] {
+                            for (int i = 0; i < 2000; ++i) {
+                                executor.submit([&]() noexcept { ++runs; });
+                                if (executor.pending() > 2)
+                                    over_capacity = true;
+                            }
+                        });
+                    }
+                    for (auto& producer : producers) {
+                        producer.join();
+                    }
+                    executor.flush();
+                    return runs.load() == 8000 && !over_capacity.load();
+                }
+                }); });
+            tests.emplace_back([] { return test("HNG_ASYNC_DEFER_BLOCK macro - captures by copy, runs inline after drain", [](auto const& /*test_name*/) {
+                {
+                    hng::async_defer_executor executor;
+                    std::atomic<int> sum{ 0 };
+                    std::atomic<int>* const target = &sum;
+                    for (int i = 1; i <= 10; ++i) {
+                        HNG_ASYNC_DEFER_BLOCK(executor, {
+                            *target += i;
+                        });
+                    }
+                    executor.drain();
+                    if (sum.load() != 55)
+                        return false;
+                    std::thread::id runner;
+                    std::thread::id* const runner_ptr = &runner;
+                    {
+                        HNG_ASYNC_DEFER_BLOCK(executor, {
+                            *runner_ptr = std::this_thread::get_id();
+                        });
+                    }
+                    return runner == std::this_thread::get_id();
+                }
+                }); });
+#endif // ^^^^ DETAIL_HNG_DEFER_HAS_CPP17
+#if DETAIL_HNG_DEFER_HAS_CPP17
+            tests.emplace_back([] { return test("defer_at_thread_exit function - runs in LIFO order on thread exit", [](auto const& /*test_name*/) {
+                {
+                    std::vector<int> order;
+                    std::thread([&order] {
+                        // Enough registrations to overflow the inline buffer, mixed with captures that never fit.
+                        for (int i = 0; i < 100; ++i) {
+                            if (i % 10 == 0) {
+                                std::array<char, 1024> large{};
+                                large[0] = char(i);
+                                hng::defer_at_thread_exit([&order, large]() noexcept { order.push_back(large[0]); });
+                            }
+                            else {
+                                hng::defer_at_thread_exit([&order, i]() noexcept { order.push_back(i); });
+                            }
+                        }
+                        if (!order.empty())
+                            order.push_back(-1);
+                    }).join();
+                    if (order.size() != 100)
+                        return false;
+                    for (int i = 0; i < 100; ++i) {
+                        if (order[static_cast<std::size_t>(i)] != 99 - i)
+                            return false;
+                    }
+                    return true;
+                }
+                }); });
+            tests.emplace_back([] { return test("defer_at_thread_exit function - registrations during exit run too", [](auto const& /*test_name*/) {
+                {
+                    std::vector<int> order;
+                    std::thread([&order] {
+                        hng::defer_at_thread_exit([&order]() noexcept { order.push_back(2); });
+                        hng::defer_at_thread_exit([&order]() noexcept {
+                            order.push_back(1);
+                            hng::defer_at_thread_exit([&order]() noexcept { order.push_back(3); });
+                        });
+                    }).join();
+                    return order == std::vector<int>{ 1, 3, 2 };
+                }
+                }); });
+#endif // ^^^^ DETAIL_HNG_DEFER_HAS_CPP17
+#if DETAIL_HNG_DEFER_HAS_COROUTINES
+            tests.emplace_back([] { return test("co_defer_scope class - async cleanups are awaited in LIFO order", [](auto const& /*test_name*/) {
+                {
+                    manual_loop loop;
+                    std::vector<int> order;
+                    int result = 0;
+                    bool done = false;
+                    // Named, so that the captures outlive the suspended coroutine.
+                    auto const coroutine = [&]() -> detached_coroutine {
+                        result = co_await hng::co_scope([&](hng::co_defer_scope& scope) -> hng::co_defer_task<int> {
+                            scope.co_defer([&]() -> hng::co_defer_task<> {
+                                co_await loop.yield();
+                                order.push_back(3);
+                            });
+                            scope.co_defer([&]() noexcept { order.push_back(2); });
+                            scope.co_defer([&]() -> hng::co_defer_task<> {
+                                co_await loop.yield();
+                                order.push_back(1);
+                                co_await loop.yield();
+                            });
+                            co_await loop.yield();
+                            order.push_back(0);
+                            co_return 42;
+                        });
+                        done = true;
+                    };
+                    coroutine();
+                    if (done || order.size() != 0)
+                        return false;
+                    loop.run();
+                    return done && result == 42 && order == std::vector<int>{ 0, 1, 2, 3 };
+                }
+                }); });
+            tests.emplace_back([] { return test("co_defer_scope class - a reference result is returned as the same reference", [](auto const& /*test_name*/) {
+                {
+                    manual_loop loop;
+                    int value = 1;
+                    int* result = nullptr;
+                    bool cleaned_up = false;
+                    auto const coroutine = [&]() -> detached_coroutine {
+                        int& ref = co_await hng::co_scope([&](hng::co_defer_scope& scope) -> hng::co_defer_task<int&> {
+                            scope.co_defer([&]() -> hng::co_defer_task<> {
+                                co_await loop.yield();
+                                cleaned_up = true;
+                            });
+                            co_return value;
+                        });
+                        result = &ref;
+                        ++ref;
+                    };
+                    coroutine();
+                    loop.run();
+                    return cleaned_up && result == &value && value == 2;
+                }
+                }); });
+#if DETAIL_HNG_DEFER_HAS_EXCEPTIONS
+            tests.emplace_back([] { return test("co_defer_scope class - exceptions are preserved like HNG_DT_DEFER_FINALLY_PRESERVE", [](auto const& /*test_name*/) {
+                {
+                    manual_loop loop;
+                    std::vector<int> order;
+                    bool preserved = false;
+                    bool as_is = false;
+                    auto const coroutine = [&]() -> detached_coroutine {
+                        try {
+                            co_await hng::co_scope([&](hng::co_defer_scope& scope) -> hng::co_defer_task<> {
+                                scope.co_defer([&]() -> hng::co_defer_task<> {
+                                    co_await loop.yield();
+                                    order.push_back(2);
+                                });
+                                scope.co_defer([&]() -> hng::co_defer_task<> {
+                                    co_await loop.yield();
+                                    order.push_back(1);
+                                    throw std::runtime_error("cleanup");
+                                });
+                                co_await loop.yield();
+                                throw std::runtime_error("body");
+                            });
+                        }
+                        catch (hng::defer_exception const& e) {
+                            try {
+                                std::rethrow_exception(e.exception_ptr());
+                            }
+                            catch (std::runtime_error const& cleanup) {
+                                preserved = std::string(cleanup.what()) == "cleanup";
+                            }
+                            try {
+                                std::rethrow_if_nested(e);
+                                preserved = false;
+                            }
+                            catch (std::runtime_error const& body) {
+                                preserved = preserved && std::string(body.what()) == "body";
+                            }
+                        }
+                        try {
+                            co_await hng::co_scope([&](hng::co_defer_scope& scope) -> hng::co_defer_task<> {
+                                scope.co_defer([&]() -> hng::co_defer_task<> {
+                                    co_await loop.yield();
+                                    throw std::runtime_error("cleanup");
+                                });
+                                co_return;
+                            });
+                        }
+                        catch (hng::defer_exception const&) {
+                        }
+                        catch (std::runtime_error const& e) {
+                            as_is = std::string(e.what()) == "cleanup";
+                        }
+                    };
+                    coroutine();
+                    loop.run();
+                    return preserved && as_is && order == std::vector<int>{ 1, 2 };
+                }
+                }); });
+#endif // ^^^^ DETAIL_HNG_DEFER_HAS_EXCEPTIONS
+#endif // ^^^^ DETAIL_HNG_DEFER_HAS_COROUTINES
+#if defined(HNG_DEFER_INSTRUMENT)
+#if DETAIL_HNG_DEFER_HAS_EXCEPTIONS
+            tests.emplace_back([] { return test("HNG_DEFER_INSTRUMENT - macro sites record runs, time and exceptional runs", [](auto const& /*test_name*/) {
+                {
+                    int block_line = 0;
+                    int dt_line = 0;
+                    int cleanups = 0;
+                    auto const run_block = [&](bool fail) {
+                        block_line = __LINE__; HNG_DEFER_BLOCK({ ++cleanups; });
+                        if (fail)
+                            throw std::runtime_error("fail");
+                    };
+                    auto const run_dt = [&](bool fail) {
+                        dt_line = __LINE__; HNG_DT_DEFER_FINALLY[&]
+                        {
+                            ++cleanups;
+                        }
+                        HNG_DT_TRY[&]
+                        {
+                            if (fail)
+                                throw std::runtime_error("fail");
+                        }
+                        HNG_DT_END;
+                    };
+                    for (int i = 0; i < 3; ++i) {
+                        run_block(false);
+                        run_dt(false);
+                    }
+                    try {
+                        run_block(true);
+                    }
+                    catch (std::runtime_error const&) {
+                    }
+                    try {
+                        run_dt(true);
+                    }
+                    catch (std::runtime_error const&) {
+                    }
+                    // Runs on another thread are included after the thread exits.
+                    std::thread([&] { run_block(false); }).join();
+
+                    auto const find = [](int line) {
+                        for (auto const& stats : hng::defer_instrument::snapshot()) {
+                            if (stats.line == static_cast<unsigned>(line) && 0 == std::strcmp(stats.file, __FILE__))
+                                return stats;
+                        }
+                        return hng::defer_instrument::site_stats{ nullptr, 0, 0, 0, 0, 0 };
+                    };
+                    auto const block = find(block_line);
+                    auto const dt = find(dt_line);
+                    std::ostringstream dump;
+                    hng::defer_instrument::dump(dump);
+                    return cleanups == 9
+                        && block.runs == 5 && block.exceptional_runs == 1 && block.max_ns <= block.total_ns
+                        && dt.runs == 4 && dt.exceptional_runs == 1
+                        && dump.str().find(std::string(__FILE__) + ":" + std::to_string(dt_line)) != std::string::npos;
+                }
+                }); });
+#endif // ^^^^ DETAIL_HNG_DEFER_HAS_EXCEPTIONS
+            tests.emplace_back([] { return test("HNG_DEFER_INSTRUMENT - const callable variable", [](auto const& /*test_name*/) {
+                {
+                    int cleanups = 0;
+                    {
+                        auto const my_callable = [&]()noexcept { ++cleanups; };
+                        HNG_DEFER_CALLABLE_VARIABLE(my_callable);
+                    }
+                    return cleanups == 1;
+                }
+                }); });
+            tests.emplace_back([] { return test("HNG_DEFER_INSTRUMENT - named finally callable is copied, not moved from", [](auto const& /*test_name*/) {
+                {
+                    auto const shared = std::make_shared<int>(0);
+                    auto fin = [shared]()noexcept { ++*shared; };
+                    HNG_DT_DEFER_FINALLY fin HNG_DT_TRY[&]
+                    {
+                    }
+                    HNG_DT_END;
+                    if (shared.use_count() != 2)
+                        return false;
+                    fin();
+                    return *shared == 2;
+                }
+                }); });
+#endif // ^^^^ HNG_DEFER_INSTRUMENT
+#if DETAIL_HNG_DEFER_HAS_CPP17
+#if DETAIL_HNG_DEFER_HAS_EXCEPTIONS
+            tests.emplace_back([] { return test("undo_log class - rolls back in LIFO order when not committed", [](auto const& /*test_name*/) {
+                {
+                    std::vector<int> values{ 1, 2, 3 };
+                    std::vector<int> undo_order;
+                    try {
+                        hng::undo_log log;
+                        for (int i = 0; i < 3; ++i) {
+                            int const previous = values[static_cast<std::size_t>(i)];
+                            values[static_cast<std::size_t>(i)] = 0;
+                            log.record([&values, &undo_order, i, previous]() noexcept {
+                                values[static_cast<std::size_t>(i)] = previous;
+                                undo_order.push_back(i);
+                            });
+                        }
+                        throw std::runtime_error("step failed");
+                    }
+                    catch (std::runtime_error const&) {
+                    }
+                    return values == std::vector<int>{ 1, 2, 3 } && undo_order == std::vector<int>{ 2, 1, 0 };
+                }
+                }); });
+#endif // ^^^^ DETAIL_HNG_DEFER_HAS_EXCEPTIONS
+            tests.emplace_back([] { return test("undo_log class - savepoints roll back partially, commit discards", [](auto const& /*test_name*/) {
+                {
+                    int a = 1;
+                    int b = 2;
+                    int c = 3;
+                    {
+                        hng::undo_log log;
+                        log.set(a, 10);
+                        auto const sp = log.savepoint();
+                        log.set(b, 20);
+                        log.set(c, 30);
+                        if (log.size() != 3)
+                            return false;
+                        log.rollback_to(sp);
+                        if (a != 10 || b != 2 || c != 3 || log.size() != 1)
+                            return false;
+                        log.set(c, 31);
+                        log.rollback_to(sp);
+                        log.rollback_to(sp);
+                        if (c != 3 || log.size() != 1)
+                            return false;
+                        log.set(b, 21);
+                        log.commit();
+                        if (!log.empty())
+                            return false;
+                        // The log is reusable after a commit.
+                        log.set(c, 32);
+                    }
+                    return a == 10 && b == 21 && c == 3;
+                }
+                }); });
+            tests.emplace_back([] { return test("undo_log class - spills to chunks and reuses them after commit", [](auto const& /*test_name*/) {
+                {
+                    std::vector<int> values(1000, 0);
+                    hng::basic_undo_log<64> log;
+                    for (int round = 0; round < 3; ++round) {
+                        for (std::size_t i = 0; i < values.size(); ++i) {
+                            log.set(values[i], round + 1);
+                        }
+                        if (log.size() != values.size())
+                            return false;
+                        if (round == 1) {
+                            log.rollback();
+                            for (int const v : values) {
+                                if (v != 1)
+                                    return false;
+                            }
+                        }
+                        else {
+                            log.commit();
+                        }
+                    }
+                    for (int const v : values) {
+                        if (v != 3)
+                            return false;
+                    }
+                    return log.empty();
+                }
+                }); });
+#endif // ^^^^ DETAIL_HNG_DEFER_HAS_CPP17
+#if DETAIL_HNG_DEFER_HAS_CPP17
+            tests.emplace_back([] { return test("unique_defer class - returned from a factory and moved into a container", [](auto const& /*test_name*/) {
+                {
+                    static_assert(sizeof(hng::unique_defer) == 4 * sizeof(void*), "three pointers of storage and one manager pointer");
+                    std::vector<int> order;
+                    auto const make = [&order](int i) { return hng::unique_defer([&order, i]() noexcept { order.push_back(i); }); };
+                    {
+                        std::vector<hng::unique_defer> cleanups;
+                        for (int i = 0; i < 20; ++i) {
+                            cleanups.push_back(make(i)); // reallocations relocate the callables
+                        }
+                        if (!order.empty())
+                            return false;
+                        while (!cleanups.empty()) {
+                            cleanups.pop_back();
+                        }
+                    }
+                    for (int i = 0; i < 20; ++i) {
+                        if (order[static_cast<std::size_t>(i)] != 19 - i)
+                            return false;
+                    }
+                    return order.size() == 20;
+                }
+                }); });
+            tests.emplace_back([] { return test("unique_defer class - move assignment, reset and release", [](auto const& /*test_name*/) {
+                {
+                    int a = 0;
+                    int b = 0;
+                    {
+                        hng::unique_defer d1([&a]() noexcept { ++a; });
+                        hng::unique_defer d2([&b]() noexcept { ++b; });
+                        d1 = std::move(d2); // invokes the callable of d1
+                        if (a != 1 || b != 0 || d2 || !d1)
+                            return false;
+                        d1.reset();
+                        d1.reset();
+                        if (b != 1 || d1)
+                            return false;
+                        d1 = hng::unique_defer([&a]() noexcept { a += 10; });
+                        d1.release();
+                        if (d1)
+                            return false;
+                        d2 = hng::unique_defer([&b]() noexcept { b += 10; });
+                    }
+                    return a == 1 && b == 11;
+                }
+                }); });
+            tests.emplace_back([] { return test("unique_defer class - compile-time capacity check", [](auto const& /*test_name*/) {
+                {
+                    int counter = 0;
+                    int* const p = &counter;
+                    auto const small = [p, q = p, r = p]() noexcept { *p += (q == r) ? 1 : 0; };
+                    auto const large = [p, q = p, r = p, s = p]() noexcept { *p += (q == r && r == s) ? 1 : 0; };
+                    auto const throwing = [p]() { ++*p; };
+                    static_assert(hng::unique_defer::fits<decltype(small)>, "three pointers fit");
+                    static_assert(!hng::unique_defer::fits<decltype(large)>, "four pointers do not fit");
+                    static_assert(hng::basic_unique_defer<4 * sizeof(void*)>::fits<decltype(large)>, "four pointers fit a larger buffer");
+                    static_assert(!hng::unique_defer::fits<decltype(throwing)>, "the callable must be noexcept");
+                    {
+                        hng::basic_unique_defer<4 * sizeof(void*)> const d(large);
+                        hng::unique_defer const e(small);
+                    }
+                    return counter == 2;
+                }
+                }); });
+#endif // ^^^^ DETAIL_HNG_DEFER_HAS_CPP17
+#if DETAIL_HNG_DEFER_HAS_CPP17
+            tests.emplace_back([] { return test("unique_resource class - as dense as the raw handle, and trivially relocatable", [](auto const& /*test_name*/) {
+                {
+                    using handle = hng::unique_resource<int, recorded_close>;
+                    struct stateful_close {
+                        int* count;
+                        void operator()(int) const noexcept { ++*count; }
+                    };
+                    static_assert(sizeof(handle) == sizeof(int), "a stateless deleter takes no space");
+                    static_assert(sizeof(handle[16]) == sizeof(int[16]), "arrays of handles are as dense as arrays of ints");
+                    static_assert(sizeof(hng::unique_resource<int, stateful_close>) == sizeof(int*) + alignof(int*), "a stateful deleter is stored");
+                    static_assert(handle::is_trivially_relocatable, "int and an empty deleter are trivially copyable");
+                    static_assert(!std::is_copy_constructible_v<handle> && std::is_nothrow_move_constructible_v<handle>, "move only");
+                    recorded_close::closed.clear();
+                    recorded_close::closed.reserve(16);
+                    {
+                        // Relocate an array of handles by copying its bytes; each handle is then closed exactly once.
+                        alignas(handle) unsigned char source[sizeof(handle[4])];
+                        alignas(handle) unsigned char target[sizeof(handle[4])];
+                        for (int i = 0; i < 4; ++i) {
+                            ::new (static_cast<void*>(source + i * sizeof(handle))) handle(10 + i);
+                        }
+                        std::memcpy(target, source, sizeof(target));
+                        handle* const relocated = std::launder(reinterpret_cast<handle*>(target));
+                        for (int i = 0; i < 4; ++i) {
+                            if (relocated[i].get() != 10 + i)
+                                return false;
+                            relocated[i].~handle();
+                        }
+                    }
+                    return recorded_close::closed == std::vector<int>{ 10, 11, 12, 13 };
+                }
+                }); });
+            tests.emplace_back([] { return test("unique_resource class - get, reset, release and move", [](auto const& /*test_name*/) {
+                {
+                    using handle = hng::unique_resource<int, recorded_close>;
+                    recorded_close::closed.clear();
+                    recorded_close::closed.reserve(16);
+                    {
+                        handle a(1);
+                        handle const empty;
+                        handle const invalid(-1);
+                        if (!a || empty || invalid || a.get() != 1 || empty.get() != -1)
+                            return false;
+                        a.reset(2);
+                        handle b(std::move(a));
+                        if (a || b.get() != 2)
+                            return false;
+                        handle c(3);
+                        c = std::move(b);
+                        if (recorded_close::closed != std::vector<int>{ 1, 3 })
+                            return false;
+                        int const released = c.release();
+                        if (released != 2 || c)
+                            return false;
+                        c.reset(4);
+                        c.reset();
+                        c.reset();
+                        std::vector<handle> handles;
+                        for (int i = 0; i < 5; ++i) {
+                            handles.emplace_back(100 + i); // reallocations move the handles without closing them
+                        }
+                        handles.erase(handles.begin());
+                        handles.emplace_back(5);
+                    }
+                    return recorded_close::closed == std::vector<int>{ 1, 3, 4, 100, 101, 102, 103, 104, 5 };
+                }
+                }); });
+#if DETAIL_HNG_UNIQUE_RESOURCE_HAS_POSIX
+            tests.emplace_back([] { return test("unique_resource class - unique_fd and unique_mmap", [](auto const& /*test_name*/) {
+                {
+                    static_assert(sizeof(hng::unique_fd) == sizeof(int), "unique_fd is an int");
+                    static_assert(sizeof(hng::unique_mmap) == sizeof(hng::mmap_region), "unique_mmap is an address and a length");
+                    int fds[2];
+                    if (::pipe(fds) != 0)
+                        return false;
+                    int const read_fd = fds[0];
+                    {
+                        hng::unique_fd const read_end(fds[0]);
+                        hng::unique_fd write_end(fds[1]);
+                        char const message = 'x';
+                        if (::write(write_end.get(), &message, 1) != 1)
+                            return false;
+                        write_end.reset();
+                        char received = 0;
+                        if (::read(read_end.get(), &received, 1) != 1 || received != 'x')
+                            return false;
+                        // The write end is closed, so the pipe is at end of file.
+                        if (::read(read_end.get(), &received, 1) != 0)
+                            return false;
+                    }
+                    if (::fcntl(read_fd, F_GETFD) != -1 || errno != EBADF)
+                        return false;
+
+                    hng::unique_mmap region = hng::make_unique_mmap(4096, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+                    if (!region || region.get().length != 4096)
+                        return false;
+                    region.get().data()[4095] = 42;
+                    hng::unique_mmap moved = std::move(region);
+                    hng::unique_mmap const failed = hng::make_unique_mmap(4096, PROT_READ, MAP_PRIVATE, -1, 0);
+                    return !region && moved.get().data()[4095] == 42 && !failed;
+                }
+                }); });
+#endif // ^^^^ DETAIL_HNG_UNIQUE_RESOURCE_HAS_POSIX
+#endif // ^^^^ DETAIL_HNG_DEFER_HAS_CPP17
+#if DETAIL_HNG_DEFER_HAS_CPP17
+            tests.emplace_back([] { return test("parallel_defer_group class - runs the cleanups concurrently and waits for them", [](auto const& /*test_name*/) {
+                {
+                    hng::parallel_defer_pool pool(2);
+                    std::atomic<int> count{ 0 };
+                    {
+                        hng::parallel_defer_group group(pool);
+                        for (int i = 0; i < 1000; ++i) {
+                            group.add([&count] { count.fetch_add(1, std::memory_order_relaxed); });
+                        }
+                        if (group.size() != 1000 || count.load() != 0)
+                            return false;
+                    }
+                    if (count.load() != 1000)
+                        return false;
+                    // Two cleanups which wait for each other only finish if they run at the same time.
+                    std::atomic<int> arrived{ 0 };
+                    std::atomic<bool> met{ true };
+                    {
+                        hng::parallel_defer_group group(pool);
+                        for (int i = 0; i < 2; ++i) {
+                            group.add([&arrived, &met] {
+                                arrived.fetch_add(1);
+                                auto const deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+                                while (arrived.load() < 2) {
+                                    if (std::chrono::steady_clock::now() > deadline) {
+                                        met.store(false);
+                                        return;
+                                    }
+                                    std::this_thread::yield();
+                                }
+                            });
+                        }
+                    }
+                    return met.load();
+                }
+                }); });
+            tests.emplace_back([] { return test("parallel_defer_group class - dependencies run after the cleanups they depend on", [](auto const& /*test_name*/) {
+                {
+                    hng::parallel_defer_pool pool(3);
+                    for (int round = 0; round < 50; ++round) {
+                        std::mutex mutex;
+                        std::vector<int> order;
+                        auto const record = [&mutex, &order](int i) {
+                            return [&mutex, &order, i] {
+                                std::lock_guard<std::mutex> const lock(mutex);
+                                order.push_back(i);
+                            };
+                        };
+                        {
+                            hng::parallel_defer_group group(pool);
+                            auto const a = group.add(record(0));
+                            auto const b = group.add(record(1), { a });
+                            auto const c = group.add(record(2), { a });
+                            group.add(record(3), { b, c });
+                            for (int i = 4; i < 20; ++i) {
+                                group.add(record(i));
+                            }
+                        }
+                        auto const position = [&order](int i) { return std::find(order.begin(), order.end(), i) - order.begin(); };
+                        if (order.size() != 20 || position(0) > position(1) || position(0) > position(2) || position(1) > position(3) || position(2) > position(3))
+                            return false;
+                    }
+#if DETAIL_HNG_DEFER_HAS_EXCEPTIONS
+                    hng::parallel_defer_group group(pool);
+                    try {
+                        group.add([] {}, { 0 });
+                    }
+                    catch (std::out_of_range const&) {
+                        return group.size() == 0;
+                    }
+                    return false;
+#else
+                    return true;
+#endif // ^^^^ DETAIL_HNG_DEFER_HAS_EXCEPTIONS
+                }
+                }); });
+#if DETAIL_HNG_DEFER_HAS_EXCEPTIONS
+            tests.emplace_back([] { return test("parallel_defer_group class - exceptions are aggregated", [](auto const& /*test_name*/) {
+                {
+                    hng::parallel_defer_pool pool(2);
+                    std::atomic<int> count{ 0 };
+                    hng::parallel_defer_group group(pool);
+                    for (int i = 0; i < 10; ++i) {
+                        group.add([&count, i] {
+                            count.fetch_add(1);
+                            if (i % 3 == 0)
+                                throw i;
+                        });
+                    }
+                    try {
+                        group.run();
+                        return false;
+                    }
+                    catch (hng::defer_aggregate_exception const& ex) {
+                        if (ex.size() != 4 || count.load() != 10 || group.size() != 0)
+                            return false;
+                    }
+                    // The destructor throws when the scope exits normally...
+                    try {
+                        hng::parallel_defer_group scoped(pool);
+                        scoped.add([] { throw std::runtime_error("cleanup"); });
+                    }
+                    catch (hng::defer_aggregate_exception const& ex) {
+                        if (ex.size() != 1)
+                            return false;
+                    }
+                    // ...and discards the exceptions of the cleanups when the scope exits by an exception.
+                    try {
+                        hng::parallel_defer_group scoped(pool);
+                        scoped.add([&count] { count.fetch_add(1); throw std::runtime_error("cleanup"); });
+                        throw std::logic_error("scope");
+                    }
+                    catch (std::logic_error const&) {
+                    }
+                    return count.load() == 11;
+                }
+                }); });
+#endif // ^^^^ DETAIL_HNG_DEFER_HAS_EXCEPTIONS
+#endif // ^^^^ DETAIL_HNG_DEFER_HAS_CPP17
+#if DETAIL_HNG_DEFER_HAS_CPP17
+            tests.emplace_back([] { return test("scoped_arena class - nested scopes roll back to their own marks", [](auto const& /*test_name*/) {
+                {
+                    alignas(std::max_align_t) unsigned char buffer[256];
+                    hng::arena arena(buffer, sizeof(buffer));
+                    void* first = nullptr;
+                    void* inner_first = nullptr;
+                    std::size_t capacity = 0;
+                    for (int round = 0; round < 3; ++round) {
+                        hng::scoped_arena outer(arena);
+                        void* const a = outer.allocate(64);
+                        if (round == 0)
+                            first = a;
+                        else if (a != first)
+                            return false; // the outer scope's memory is reused from the start
+                        {
+                            hng::scoped_arena inner(outer);
+                            void* const b = inner.allocate(128);
+                            for (int i = 0; i < 100; ++i) {
+                                inner.allocate(1000); // spills to chunks
+                            }
+                            if (round == 0)
+                                inner_first = b;
+                            else if (b != inner_first)
+                                return false;
+                        }
+                        if (outer.allocate(16) != static_cast<unsigned char*>(a) + 64)
+                            return false; // the inner scope rolled back to its own mark only
+                        if (round == 0)
+                            capacity = arena.capacity();
+                        else if (arena.capacity() != capacity)
+                            return false; // chunks are kept and reused
+                    }
+                    if (capacity == 0)
+                        return false;
+                    // Over-aligned allocations.
+                    hng::scoped_arena scope(arena);
+                    scope.allocate(1, 1);
+                    void* const aligned = scope.allocate(100, 256);
+                    return reinterpret_cast<std::size_t>(aligned) % 256 == 0;
+                }
+                }); });
+            tests.emplace_back([] { return test("scoped_arena class - only registered objects are destroyed, in reverse order", [](auto const& /*test_name*/) {
+                {
+                    struct logged {
+                        std::vector<int>* log;
+                        int value;
+                        logged(std::vector<int>* l, int v) : log(l), value(v) {}
+                        ~logged() { log->push_back(value); }
+                    };
+#if DETAIL_HNG_DEFER_HAS_EXCEPTIONS
+                    struct throwing {
+                        explicit throwing(int) { throw std::runtime_error("construction"); }
+                        ~throwing() {}
+                    };
+#endif // ^^^^ DETAIL_HNG_DEFER_HAS_EXCEPTIONS
+                    std::vector<int> log;
+                    counted::reset();
+                    hng::arena arena;
+                    {
+                        hng::scoped_arena outer(arena);
+                        outer.make<logged>(&log, 1);
+                        int* const plain = outer.make<int>(7);
+                        {
+                            hng::scoped_arena inner(outer);
+                            inner.make<logged>(&log, 2);
+                            inner.make<counted>(5);
+                            inner.make<logged>(&log, 3);
+                            if (counted::live != 1)
+                                return false;
+                        }
+                        if (log != std::vector<int>{ 3, 2 } || counted::live != 0 || *plain != 7)
+                            return false;
+#if DETAIL_HNG_DEFER_HAS_EXCEPTIONS
+                        hng::arena::marker const before = arena.mark();
+                        try {
+                            outer.make<throwing>(0);
+                            return false;
+                        }
+                        catch (std::runtime_error const&) {
+                        }
+                        hng::arena::marker const after = arena.mark();
+                        if (after.m_cursor != before.m_cursor || after.m_destructors != before.m_destructors)
+                            return false; // a failed construction releases its memory
+#endif // ^^^^ DETAIL_HNG_DEFER_HAS_EXCEPTIONS
+                        outer.make<logged>(&log, 4);
+                    }
+                    return log == std::vector<int>{ 3, 2, 4, 1 } && counted::constructions == 1;
+                }
+                }); });
+#if DETAIL_HNG_DEFER_HAS_EXCEPTIONS
+            tests.emplace_back([] { return test("scoped_arena class - a failed make in a new chunk releases the destructor node", [](auto const& /*test_name*/) {
+                {
+                    // The destructor node fits in the buffer, the object needs a new chunk, and its constructor throws.
+                    struct large {
+                        unsigned char bytes[512];
+                        large() { throw std::runtime_error("construction"); }
+                        ~large() {}
+                    };
+                    struct small {
+                        ~small() {}
+                    };
+                    alignas(std::max_align_t) unsigned char buffer[128];
+                    hng::arena arena(buffer, sizeof(buffer));
+                    hng::scoped_arena scope(arena);
+                    scope.make<small>();
+                    hng::arena::marker const before = arena.mark();
+                    try {
+                        scope.make<large>();
+                        return false;
+                    }
+                    catch (std::runtime_error const&) {
+                    }
+                    hng::arena::marker const after = arena.mark();
+                    return after.m_chunk == before.m_chunk && after.m_cursor == before.m_cursor && after.m_destructors == before.m_destructors
+                        && before.m_chunk == nullptr && before.m_destructors != nullptr && arena.capacity() > 0;
+                }
+                }); });
+#endif // ^^^^ DETAIL_HNG_DEFER_HAS_EXCEPTIONS
+            tests.emplace_back([] { return test("scoped_arena class - arena_allocator for standard containers", [](auto const& /*test_name*/) {
+                {
+                    hng::arena arena;
+                    hng::arena::marker const empty = arena.mark();
+                    {
+                        hng::scoped_arena scope(arena);
+                        std::vector<int, hng::arena_allocator<int>> values(scope.allocator<int>());
+                        for (int i = 0; i < 1000; ++i) {
+                            values.push_back(i);
+                        }
+                        using string = std::basic_string<char, std::char_traits<char>, hng::arena_allocator<char>>;
+                        string text("a string which is too long for the small string buffer", scope.allocator<char>());
+                        hng::arena_allocator<char> const rebound(values.get_allocator());
+                        if (!(rebound == text.get_allocator()) || &rebound.get_arena() != &arena)
+                            return false;
+                        // Allocators of different value types compare equal when they use the same arena.
+                        hng::arena other;
+                        hng::arena_allocator<long> const elsewhere(other);
+                        if (!(values.get_allocator() == text.get_allocator()) || values.get_allocator() != text.get_allocator()
+                            || values.get_allocator() == elsewhere || !(values.get_allocator() != elsewhere))
+                            return false;
+                        long long sum = 0;
+                        for (int const value : values) {
+                            sum += value;
+                        }
+                        if (sum != 999 * 1000 / 2 || text.size() != 54)
+                            return false;
+                    }
+                    return arena.mark().m_cursor == empty.m_cursor && arena.capacity() > 0;
+                }
+                }); });
+#if DETAIL_HNG_DEFER_HAS_EXCEPTIONS
+            tests.emplace_back([] { return test("scoped_arena class - oversized allocations throw std::bad_alloc", [](auto const& /*test_name*/) {
+                {
+                    hng::arena arena;
+                    hng::arena::marker const empty = arena.mark();
+                    int failures = 0;
+                    for (std::size_t const size : { std::size_t(-1), std::size_t(-1) - 1 }) {
+                        try {
+                            hng::arena_allocator<char>(arena).allocate(size);
+                        }
+                        catch (std::bad_alloc const&) {
+                            ++failures;
+                        }
+                    }
+                    try {
+                        arena.allocate(std::size_t(-1) - 8, 4 * alignof(std::max_align_t));
+                    }
+                    catch (std::bad_alloc const&) {
+                        ++failures;
+                    }
+                    return failures == 3 && arena.mark().m_cursor == empty.m_cursor && arena.capacity() == 0;
+                }
+                }); });
+#endif // ^^^^ DETAIL_HNG_DEFER_HAS_EXCEPTIONS
+#endif // ^^^^ DETAIL_HNG_DEFER_HAS_CPP17
+#if DETAIL_HNG_DEFER_HAS_CPP17
+            tests.emplace_back([] { return test("HNG_DT_CHAIN/AND/TRY/END macros - finally blocks run in reverse order after the result", [](auto const& /*test_name*/) {
+                {
+                    std::vector<int> order;
+                    int const value = HNG_DT_CHAIN[&]
+                    {
+                        order.push_back(1);
+                    }
+                    HNG_DT_AND[&]
+                    {
+                        order.push_back(2);
+                    }
+                    HNG_DT_AND[&]() noexcept
+                    {
+                        order.push_back(3);
+                    }
+                    HNG_DT_TRY[&]
+                    {
+                        order.push_back(0);
+                        return 7;
+                    }
+                    HNG_DT_END;
+                    if (value != 7 || order != std::vector<int>{ 0, 3, 2, 1 })
+                        return false;
+                    // A prvalue result is constructed once, before the finally blocks run.
+                    counted::reset();
+                    int live_in_finally = -1;
+                    counted const result = HNG_DT_CHAIN[&]() noexcept
+                    {
+                        live_in_finally = counted::live;
+                    }
+                    HNG_DT_AND[&]() noexcept
+                    {
+                    }
+                    HNG_DT_TRY[&]
+                    {
+                        return counted(5);
+                    }
+                    HNG_DT_END;
+                    int x = 1;
+                    int& reference = HNG_DT_CHAIN[&]
+                    {
+                        ++x;
+                    }
+                    HNG_DT_TRY[&]() -> int&
+                    {
+                        return x;
+                    }
+                    HNG_DT_END;
+                    return result.payload[0] == 5 && counted::constructions == 1 && live_in_finally == 1 && &reference == &x && x == 2;
+                }
+                }); });
+#if DETAIL_HNG_DEFER_HAS_EXCEPTIONS
+            tests.emplace_back([] { return test("HNG_DT_CHAIN/AND/TRY/END macros - exceptions are preserved like nested HNG_DT_DEFER_FINALLY_PRESERVE", [](auto const& /*test_name*/) {
+                {
+                    // Flattens a preserved exception: the defer_exception's exception first, then the nested ones.
+                    auto const messages = [](std::exception_ptr e) {
+                        std::vector<std::string> result;
+                        while (e) {
+                            std::exception_ptr next;
+                            try {
+                                std::rethrow_exception(e);
+                            }
+                            catch (hng::defer_exception const& dex) {
+                                try {
+                                    std::rethrow_exception(dex.exception_ptr());
+                                }
+                                catch (std::runtime_error const& ex) {
+                                    result.push_back(ex.what());
+                                }
+                                try {
+                                    std::rethrow_if_nested(dex);
+                                }
+                                catch (...) {
+                                    next = std::current_exception();
+                                }
+                            }
+                            catch (std::runtime_error const& ex) {
+                                result.push_back(ex.what());
+                            }
+                            e = next;
+                        }
+                        return result;
+                    };
+                    auto const capture = [](auto&& f) {
+                        try {
+                            f();
+                        }
+                        catch (...) {
+                            return std::current_exception();
+                        }
+                        return std::exception_ptr();
+                    };
+                    for (bool const try_throws : { false, true }) {
+                        int runs = 0;
+                        std::exception_ptr const chained = capture([&] {
+                            HNG_DT_CHAIN[&]
+                            {
+                                ++runs;
+                                throw std::runtime_error("f1");
+                            }
+                            HNG_DT_AND[&]
+                            {
+                                ++runs;
+                            }
+                            HNG_DT_AND[&]
+                            {
+                                ++runs;
+                                throw std::runtime_error("f3");
+                            }
+                            HNG_DT_TRY[&]
+                            {
+                                if (try_throws)
+                                    throw std::runtime_error("try");
+                            }
+                            HNG_DT_END;
+                        });
+                        std::exception_ptr const nested = capture([&] {
+                            HNG_DT_DEFER_FINALLY_PRESERVE[&]
+                            {
+                                throw std::runtime_error("f1");
+                            }
+                            HNG_DT_TRY[&]
+                            {
+                                HNG_DT_DEFER_FINALLY_PRESERVE[&]
+                                {
+                                }
+                                HNG_DT_TRY[&]
+                                {
+                                    HNG_DT_DEFER_FINALLY_PRESERVE[&]
+                                    {
+                                        throw std::runtime_error("f3");
+                                    }
+                                    HNG_DT_TRY[&]
+                                    {
+                                        if (try_throws)
+                                            throw std::runtime_error("try");
+                                    }
+                                    HNG_DT_END;
+                                }
+                                HNG_DT_END;
+                            }
+                            HNG_DT_END;
+                        });
+                        std::vector<std::string> expected{ "f1", "f3" };
+                        if (try_throws)
+                            expected.push_back("try");
+                        if (runs != 3 || messages(chained) != expected || messages(nested) != expected)
+                            return false;
+                    }
+                    // Without exceptions from the finally blocks, the try block exception propagates as-is.
+                    int runs = 0;
+                    try {
+                        HNG_DT_CHAIN[&]
+                        {
+                            ++runs;
+                        }
+                        HNG_DT_AND[&]
+                        {
+                            ++runs;
+                        }
+                        HNG_DT_TRY[&]
+                        {
+                            throw std::logic_error("try");
+                        }
+                        HNG_DT_END;
+                    }
+                    catch (std::logic_error const& ex) {
+                        return runs == 2 && 0 == std::strcmp(ex.what(), "try");
+                    }
+                    return false;
+                }
+                }); });
+#endif // ^^^^ DETAIL_HNG_DEFER_HAS_EXCEPTIONS
+#endif // ^^^^ DETAIL_HNG_DEFER_HAS_CPP17
+#if DETAIL_HNG_DEFER_HAS_CPP20_CONSTEXPR && !defined(HNG_DEFER_INSTRUMENT)
+            tests.emplace_back([] { return test("constexpr defer and HNG_DT constructs - cleanup order during constant evaluation", [](auto const& /*test_name*/) {
+                {
+                    static_assert(constexpr_defer_order().equals({ 0, 4, 3, 2, 1 }));
+                    static_assert(constexpr_dt_order().equals({ 1, 2, 10, 3, 4, 11, 5, 6, 7, 8, 9 }));
+                    // The same functions evaluated at run time.
+                    return constexpr_defer_order().equals({ 0, 4, 3, 2, 1 }) && constexpr_dt_order().equals({ 1, 2, 10, 3, 4, 11, 5, 6, 7, 8, 9 });
+                }
+                }); });
+#endif // ^^^^ DETAIL_HNG_DEFER_HAS_CPP20_CONSTEXPR
+#if DETAIL_HNG_UNIQUE_RESOURCE_HAS_POSIX
+            tests.emplace_back([] { return test("shutdown_defer function - full and fast exit of a child process", [](auto const& /*test_name*/) {
+                {
+                    // Forks a child which registers cleanups writing one character each to a pipe, then exits;
+                    // returns what the cleanups wrote and the exit status of the child.
+                    auto const shutdown_child = [](bool fast, std::string& written, int& status) {
+                        int fds[2];
+                        if (::pipe(fds) != 0)
+                            return false;
+                        std::cout.flush();
+                        std::cerr.flush();
+                        std::fflush(nullptr);
+                        pid_t const pid = ::fork();
+                        if (pid == 0) {
+                            ::close(fds[0]);
+                            int const fd = fds[1];
+                            auto const emit = [fd](char c) noexcept {
+                                ssize_t const result = ::write(fd, &c, 1);
+                                static_cast<void>(result);
+                            };
+                            hng::shutdown_defer([emit]() noexcept { emit('a'); }, hng::shutdown_cleanup::skippable);
+                            hng::shutdown_defer([emit]() noexcept { emit('E'); }, hng::shutdown_cleanup::essential, 10);
+                            hng::shutdown_defer([emit]() noexcept { emit('b'); }, hng::shutdown_cleanup::skippable);
+                            hng::shutdown_defer([emit]() noexcept {
+                                emit('e');
+                                // Registered once the shutdown has begun: invoked immediately, unless skipped.
+                                hng::shutdown_defer([emit]() noexcept { emit('n'); }, hng::shutdown_cleanup::essential);
+                                hng::shutdown_defer([emit]() noexcept { emit('s'); }, hng::shutdown_cleanup::skippable);
+                            }, hng::shutdown_cleanup::essential, -5);
+                            if (fast)
+                                hng::fast_exit(3);
+                            std::exit(4);
+                        }
+                        ::close(fds[1]);
+                        if (pid < 0) {
+                            ::close(fds[0]);
+                            return false;
+                        }
+                        char buffer[16];
+                        ssize_t n;
+                        while ((n = ::read(fds[0], buffer, sizeof(buffer))) > 0) {
+                            written.append(buffer, std::size_t(n));
+                        }
+                        ::close(fds[0]);
+                        return ::waitpid(pid, &status, 0) == pid;
+                    };
+                    std::string full;
+                    int full_status = 0;
+                    std::string fast;
+                    int fast_status = 0;
+                    if (!shutdown_child(false, full, full_status) || !shutdown_child(true, fast, fast_status))
+                        return false;
+                    // By decreasing priority, then in reverse order of registration.
+                    return full == "Ebaens" && WIFEXITED(full_status) && WEXITSTATUS(full_status) == 4
+                        && fast == "Een" && WIFEXITED(fast_status) && WEXITSTATUS(fast_status) == 3;
+                }
+                }); });
+#endif // ^^^^ DETAIL_HNG_UNIQUE_RESOURCE_HAS_POSIX
+#if DETAIL_HNG_DEFER_HAS_CPP17
+            tests.emplace_back([] { return test("coalescing_scope class - defer_once keeps the first callable per key, in insertion order", [](auto const& /*test_name*/) {
+                {
+                    enum class job { flush, reindex };
+                    std::vector<int> order;
+                    // Nested code reaches the scope through hng::defer_once.
+                    auto const request = [&order](auto key, int id) {
+                        return hng::defer_once(key, [&order, id]() noexcept { order.push_back(id); });
+                    };
+                    int file_a = 0;
+                    int file_b = 0;
+                    {
+                        hng::coalescing_scope tick;
+                        if (hng::coalescing_scope::current() != &tick)
+                            return false;
+                        if (!request(&file_b, 1) || !request(job::reindex, 2) || !request(&file_a, 3) || !request(42, 4))
+                            return false;
+                        if (request(&file_b, 5) || request(job::reindex, 6) || request(&file_a, 7) || request(42, 8))
+                            return false;
+                        if (!request(job::flush, 9) || tick.size() != 5)
+                            return false;
+                        {
+                            // The innermost scope is the target, and runs first.
+                            hng::coalescing_scope inner;
+                            if (!request(&file_b, 10) || request(&file_b, 11))
+                                return false;
+                        }
+                        if (hng::coalescing_scope::current() != &tick || order != std::vector<int>{ 10 })
+                            return false;
+                    }
+                    if (hng::coalescing_scope::current() != nullptr || order != std::vector<int>{ 10, 1, 2, 3, 4, 9 })
+                        return false;
+                    // Without a scope, the callable runs immediately.
+                    return request(&file_a, 12) && request(&file_a, 13) && order.back() == 13 && order.size() == 8;
+                }
+                }); });
+            tests.emplace_back([] { return test("coalescing_scope class - keys of different types with the same value are different keys", [](auto const& /*test_name*/) {
+                {
+                    enum class job { flush, reindex };
+                    enum class stage { load, reindex };
+                    std::vector<int> order;
+                    auto const request = [&order](auto key, int id) {
+                        return hng::defer_once(key, [&order, id]() noexcept { order.push_back(id); });
+                    };
+                    int file = 0;
+                    std::uintptr_t const file_address = reinterpret_cast<std::uintptr_t>(&file);
+                    {
+                        hng::coalescing_scope tick;
+                        // job::reindex, stage::reindex and 1 all have the value 1; a pointer and its address have the same value.
+                        if (!request(job::reindex, 1) || !request(stage::reindex, 2) || !request(1, 3) || !request(1u, 4))
+                            return false;
+                        if (!request(&file, 5) || !request(file_address, 6))
+                            return false;
+                        // A pointer to const is the same key as a pointer to the same object.
+                        if (request(static_cast<int const*>(&file), 7) || request(job::reindex, 8) || request(1, 9) || tick.size() != 6)
+                            return false;
+                    }
+                    return order == std::vector<int>{ 1, 2, 3, 4, 5, 6 };
+                }
+                }); });
+            tests.emplace_back([] { return test("coalescing_scope class - growth, deferral while running and reuse", [](auto const& /*test_name*/) {
+                {
+                    std::vector<int> order;
+                    hng::coalescing_scope scope;
+                    // More keys than the inline table holds, each requested three times.
+                    for (int round = 0; round < 3; ++round) {
+                        for (int key = 0; key < 1000; ++key) {
+                            bool const kept = scope.defer_once(key, [&order, key]() noexcept { order.push_back(key); });
+                            if (kept != (round == 0))
+                                return false;
+                        }
+                    }
+                    if (scope.size() != 1000)
+                        return false;
+                    scope.run();
+                    if (order.size() != 1000 || !scope.empty())
+                        return false;
+                    for (int key = 0; key < 1000; ++key) {
+                        if (order[std::size_t(key)] != key)
+                            return false;
+                    }
+                    // A callable may defer more work: a pending key is coalesced, a key which already ran runs again.
+                    order.clear();
+                    std::string captured(64, 'x'); // a callable which is not trivially destructible
+                    scope.defer_once(1, [&order, captured]() noexcept { order.push_back(int(captured.size())); });
+                    scope.defer_once(2, [&order, &scope]() noexcept {
+                        order.push_back(2);
+                        scope.defer_once(1, [&order]() noexcept { order.push_back(-1); });
+                        scope.defer_once(3, [&order]() noexcept { order.push_back(-3); });
+                        scope.defer_once(3, [&order]() noexcept { order.push_back(-4); });
+                    });
+                    scope.run();
+                    return order == std::vector<int>{ 64, 2, -1, -3 } && scope.empty();
+                }
+                }); });
+#endif // ^^^^ DETAIL_HNG_DEFER_HAS_CPP17
+#if DETAIL_HNG_DEFER_HAS_CPP17
+            tests.emplace_back([] { return test("deferred_lock_guard class - callables run after the unlock, in reverse order", [](auto const& /*test_name*/) {
+                {
+                    std::mutex mutex;
+                    std::vector<int> order;
+                    bool unlocked_when_run = true;
+                    // Each callable checks that the mutex is free by locking it.
+                    auto const deferred = [&](int id) {
+                        return [&, id]() noexcept {
+                            if (mutex.try_lock()) {
+                                mutex.unlock();
+                            }
+                            else {
+                                unlocked_when_run = false;
+                            }
+                            order.push_back(id);
+                        };
+                    };
+                    {
+                        hng::deferred_lock_guard<std::mutex> guard(mutex);
+                        if (!guard.owns_lock() || !guard.after_unlock(deferred(1)) || !guard.after_unlock(deferred(2)))
+                            return false;
+                        auto owned = std::make_unique<int>(3);
+                        if (!guard.after_unlock([&order, owned = std::move(owned)]() noexcept { order.push_back(*owned); }))
+                            return false;
+                        if (!order.empty())
+                            return false;
+                    }
+                    if (order != std::vector<int>{ 3, 2, 1 } || !unlocked_when_run)
+                        return false;
+                    // unlock() releases the mutex early; later callables run immediately.
+                    order.clear();
+                    mutex.lock();
+                    hng::deferred_lock_guard<std::mutex> adopted(mutex, std::adopt_lock);
+                    adopted.after_unlock(deferred(4));
+                    adopted.unlock();
+                    if (adopted.owns_lock() || order != std::vector<int>{ 4 } || adopted.after_unlock(deferred(5)))
+                        return false;
+                    return order == std::vector<int>{ 4, 5 } && unlocked_when_run;
+                }
+                }); });
+            tests.emplace_back([] { return test("deferred_lock_guard class - callables beyond the inline buffer are deferred too", [](auto const& /*test_name*/) {
+                {
+                    std::mutex mutex;
+                    std::vector<int> order;
+                    {
+                        hng::deferred_lock_guard<std::mutex, 64> guard(mutex);
+                        for (int i = 0; i < 8; ++i) {
+                            // Locking the mutex again would deadlock if the callable ran while the guard holds it.
+                            if (!guard.after_unlock([&mutex, &order, i]() noexcept {
+                                std::lock_guard<std::mutex> const relocked(mutex);
+                                order.push_back(i);
+                            }))
+                                return false;
+                        }
+                        if (!order.empty())
+                            return false;
+                    }
+                    return order == std::vector<int>{ 7, 6, 5, 4, 3, 2, 1, 0 };
+                }
+                }); });
+            tests.emplace_back([] { return test("deferred_lock_guard class - a callable larger than the inline buffer spills to the heap", [](auto const& /*test_name*/) {
+                {
+                    std::mutex mutex;
+                    std::vector<int> order;
+                    {
+                        hng::deferred_lock_guard<std::mutex, 64> guard(mutex);
+                        std::array<int, 32> values{};
+                        values[31] = 2;
+                        static_assert(sizeof(values) > 64, "the callable must not fit in the inline buffer");
+                        guard.after_unlock([&order]() noexcept { order.push_back(1); });
+                        guard.after_unlock([&mutex, &order, values]() noexcept {
+                            std::lock_guard<std::mutex> const relocked(mutex);
+                            order.push_back(values[31]);
+                        });
+                        guard.after_unlock([&order]() noexcept { order.push_back(3); });
+                    }
+                    return order == std::vector<int>{ 3, 2, 1 };
+                }
+                }); });
+#endif // ^^^^ DETAIL_HNG_DEFER_HAS_CPP17
 
 
             bool all = true;
@@ -346,21 +2567,34 @@ namespace hng {
                 }
             }
             if (!all) {
+#if DETAIL_HNG_DEFER_HAS_EXCEPTIONS
                 throw std::runtime_error("Some tests failed");
+#else
+                std::cerr << "Testing failed: Some tests failed" << std::endl;
+                std::exit(1);
+#endif // ^^^^ DETAIL_HNG_DEFER_HAS_EXCEPTIONS
             }
         }
     }
 }
 
 int main() {
+#if DETAIL_HNG_DEFER_HAS_EXCEPTIONS
     try {
         hng::defer_tests::run_tests();
         std::cout << "All tests passed." << std::endl;
     }
     catch (std::exception const& ex) {
         std::cerr << "Testing failed: " << ex.what() << std::endl;
+        return 1;
     }
     catch (...) {
         std::cerr << "Testing failed" << std::endl;
+        return 1;
     }
+#else
+    hng::defer_tests::run_tests();
+    std::cout << "All tests passed." << std::endl;
+#endif // ^^^^ DETAIL_HNG_DEFER_HAS_EXCEPTIONS
+    return 0;
 }